@@ -38,4 +38,9 @@
  */
 #define DEVICE_INT_COUNT (82+16)
 
+/**
+ * @brief Core clock in Hz (CMSIS, defined in system_stm32f4xx.c).
+ */
+extern uint32_t SystemCoreClock;
+
 #endif // DEVICE_SPECS_H
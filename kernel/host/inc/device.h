@@ -0,0 +1,141 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file device.h
+ *
+ * @brief Host device header. Replaces the device header of a real device so that device independent kernel modules
+ * (for example heap.c) can be compiled natively for tests and benchmarks on the development machine.
+ * Core intrinsics are emulated for a single core without interrupts. Tests can emulate an interrupt while the core sleeps
+ * with host_waitHook (see __WFE) or at the end of a kernel critical section with host_irqHook.
+ */
+
+#ifndef DEVICE_SPECS_H
+#define DEVICE_SPECS_H
+
+#include <kernel.h>
+
+/**
+ * @brief Number of interrupts.
+ */
+#define DEVICE_INT_COUNT (82+16)
+
+/********** core intrinsics **********/
+
+/**
+ * @brief Emulated IPSR register (0 in thread mode, an exception number in handler mode).
+ */
+extern uint32_t host_ipsr;
+
+/**
+ * @brief Emulated BASEPRI register, raised by int_enterCritical (interrupt.c is replaced by host.c).
+ */
+extern uint32_t host_basepri;
+
+/**
+ * @brief Called in emulated handler mode if not NULL whenever int_exitCritical lowers the interrupt mask to 0,
+ * emulates an interrupt which was pended during the critical section. The hook isn't called again while it runs.
+ */
+extern void (*host_irqHook)(void);
+
+static inline uint32_t __get_IPSR(void)
+{
+	return host_ipsr;
+}
+
+static inline uint32_t __CLZ(uint32_t value)
+{
+	return (value != 0) ? (uint32_t)__builtin_clz(value) : 32;
+}
+
+static inline uint32_t __RBIT(uint32_t value)
+{
+	uint32_t result = 0;
+	for (int i = 0; i < 32; i++, value >>= 1)
+		result = (result << 1) | (value & 1);
+	return result;
+}
+
+//exclusive accesses always succeed (no interrupts on the host)
+static inline uint32_t __LDREXW(volatile uint32_t* addr)
+{
+	return *addr;
+}
+
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t* addr)
+{
+	*addr = value;
+	return 0;
+}
+
+static inline void __CLREX(void)
+{
+}
+
+static inline void __DMB(void)
+{
+	__sync_synchronize();
+}
+
+/**
+ * @brief Called by __WFE if not NULL, emulates an interrupt which wakes the core (for example a driver completing a request).
+ */
+extern void (*host_waitHook)(void);
+
+static inline void __SEV(void)
+{
+}
+
+static inline void __WFE(void)
+{
+	if (host_waitHook != NULL)
+		host_waitHook();
+}
+
+/********** DWT cycle counter **********/
+
+typedef struct
+{
+	volatile uint32_t CTRL;
+	volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+	volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern DWT_Type host_dwt;
+extern CoreDebug_Type host_coreDebug;
+
+#define DWT (&host_dwt)
+#define CoreDebug (&host_coreDebug)
+#define CoreDebug_DEMCR_TRCENA_Msk (1U << 24)
+#define DWT_CTRL_CYCCNTENA_Msk (1U << 0)
+
+/**
+ * @brief Core clock in Hz.
+ */
+extern uint32_t SystemCoreClock;
+
+#endif // DEVICE_SPECS_H
@@ -0,0 +1,58 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file firstfit.h
+ *
+ * @brief First-fit allocator. The heap implementation before the TLSF allocator (one address ordered free list),
+ * kept as reference for benchmarks.
+ */
+
+#ifndef FIRSTFIT_H
+#define FIRSTFIT_H
+
+#include <kernel.h>
+
+/**
+ * @brief Initialize the allocator on a memory block.
+ * @param mem The memory (aligned with 4). Must be not NULL.
+ * @param size The size of the memory.
+ */
+void firstfit_init(void* mem, size_t size);
+
+/**
+ * @brief Allocate memory (see heap_alloc).
+ */
+void* firstfit_alloc(size_t size);
+
+/**
+ * @brief Free memory (see heap_free).
+ */
+void firstfit_free(void* mem);
+
+/**
+ * @brief Returns the size of the free memory.
+ */
+size_t firstfit_getFreeMem(void);
+
+#endif // FIRSTFIT_H
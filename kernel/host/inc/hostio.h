@@ -0,0 +1,60 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file hostio.h
+ *
+ * @brief Host I/O module. Output, input and time measurement for host tools. Implemented with the C library in a separate
+ * translation unit, because the kernel headers replace standard definitions (for example size_t and NULL).
+ */
+
+#ifndef HOSTIO_H
+#define HOSTIO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Print formatted text to stdout (printf format).
+ */
+void hostio_printf(const char* fmt, ...);
+
+/**
+ * @brief Read a line from stdin (without line break).
+ * @param buf Buffer for the line.
+ * @param size Size of the buffer, longer lines are truncated.
+ * @return False at end of input.
+ */
+bool hostio_readLine(char* buf, int size);
+
+/**
+ * @brief Returns a monotonic timestamp in nanoseconds.
+ */
+uint64_t hostio_nanoseconds(void);
+
+/**
+ * @brief Terminate the process with an exit code.
+ */
+void hostio_exit(int code);
+
+#endif // HOSTIO_H
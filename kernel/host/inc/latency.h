@@ -0,0 +1,73 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file latency.h
+ *
+ * @brief Latency module. Collects operation latencies of host benchmarks in a histogram and calculates percentiles.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+/**
+ * @brief Width of a histogram bucket in nanoseconds.
+ */
+#define LATENCY_BUCKET_NS 10
+
+/**
+ * @brief Number of histogram buckets, longer latencies are counted in the last bucket.
+ */
+#define LATENCY_BUCKET_COUNT 10000
+
+typedef struct Latency
+{
+	uint64_t count;							/**< Number of operations **/
+	uint64_t totalNs;						/**< Sum of all latencies **/
+	uint64_t maxNs;							/**< Longest latency **/
+	uint32_t buckets[LATENCY_BUCKET_COUNT];	/**< Histogram **/
+} Latency;
+
+/**
+ * @brief Reset the latency statistics.
+ */
+void latency_init(Latency* latency);
+
+/**
+ * @brief Add an operation latency.
+ */
+void latency_add(Latency* latency, uint64_t ns);
+
+/**
+ * @brief Returns the latency which percent of the operations don't exceed (upper bucket bound).
+ */
+uint64_t latency_percentile(const Latency* latency, uint32_t percent);
+
+/**
+ * @brief Print count, average, p50, p99 and maximum in one line with hostio_printf.
+ */
+void latency_print(const char* name, const Latency* latency);
+
+#endif // LATENCY_H
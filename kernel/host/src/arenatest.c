@@ -0,0 +1,273 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host test of the arena allocator.
+ *
+ * Directed cases check alignment, chunk use, dedicated chunks of oversized allocations, size overflows and markers.
+ * A randomized workload allocates and resets to nested markers, after every operation:
+ * - memory of live allocations is untouched (every allocation is filled with a pattern which is verified)
+ * - allocated bytes, chunk count and chunk memory match the statistics
+ * - resetting to a marker restores the arena and returns the younger chunks to heap
+ */
+
+#include <arena.h>
+#include <heap.h>
+#include <device.h>
+#include "hostio.h"
+
+#define ALLOC_COUNT 256
+#define MARKER_COUNT 16
+#define OPERATION_COUNT 100000
+#define FULL_CHECK_OPERATIONS 10000	//check after every operation until then, afterwards after every 64th operation
+
+typedef struct Allocation
+{
+	uint8_t* mem;		//allocated memory
+	size_t size;		//requested size
+	uint8_t pattern;	//fill byte
+} Allocation;
+
+typedef struct Marker
+{
+	Arena_Marker marker;
+	size_t allocCount;	//number of live allocations when the marker was taken
+	size_t heapFree;	//free heap memory when the marker was taken
+} Marker;
+
+static Allocation allocs[ALLOC_COUNT];
+static size_t allocCount;
+static Marker markers[MARKER_COUNT];
+static size_t markerCount;
+static uint32_t randomState = 1;
+static uint32_t operation;
+
+static uint32_t nextRandom(void)
+{
+	randomState = randomState * 1664525U + 1013904223U;
+	return randomState >> 8;
+}
+
+static void check(bool condition, const char* message)
+{
+	if (condition)
+		return;
+
+	hostio_printf("arenatest: FAILED after operation %u: %s\n", operation, message);
+	hostio_exit(1);
+}
+
+static size_t heapFree(void)
+{
+	size_t heapSize, allocMem, freeMem;
+	heap_getStats(&heapSize, &allocMem, &freeMem);
+	return freeMem;
+}
+
+static size_t aligned(size_t size)
+{
+	return (size + 3) & ~3U;
+}
+
+/********** directed tests **********/
+
+static void testAlloc(void)
+{
+	size_t initialFree = heapFree();
+	Arena arena;
+	arena_init(&arena, "alloc", 10, HEAP_ATTR_ANY);
+	check(arena.chunkSize == 12, "chunk size is not aligned to 4");
+	arena_init(&arena, "alloc", 0, HEAP_ATTR_ANY);
+	check(arena.chunkSize == ARENA_CHUNK_SIZE && arena.chunkCount == 0, "default initialization is wrong");
+
+	//allocations are bumped in 4 byte steps
+	uint8_t* a = arena_alloc(&arena, 5);
+	uint8_t* b = arena_alloc(&arena, 3);
+	check(a != NULL && ((uintptr_t)a & 3) == 0 && b == a + 8, "allocations are not aligned and consecutive");
+	check(arena.chunkCount == 1 && arena.allocMem == 12, "arena statistics are wrong");
+
+	//invalid and overflowing sizes fail without touching the current chunk
+	check(arena_alloc(&arena, 0) == NULL, "empty allocation succeeded");
+	check(arena_alloc(&arena, SIZE_MAX) == NULL, "allocation of SIZE_MAX succeeded");
+	check(arena_alloc(&arena, SIZE_MAX - 2) == NULL, "aligned size overflow is not detected");
+	check(arena_alloc(&arena, SIZE_MAX - 8) == NULL, "chunk size overflow is not detected");
+	check(arena.chunkCount == 1 && arena.allocMem == 12, "failed allocations changed the arena");
+
+	//oversized allocations get a dedicated chunk, the current chunk stays in use
+	uint8_t* large = arena_alloc(&arena, ARENA_CHUNK_SIZE + 1);
+	check(large != NULL && arena.chunkCount == 2, "oversized allocation has no dedicated chunk");
+	check(arena_alloc(&arena, 4) == b + 4, "current chunk was abandoned for an oversized allocation");
+
+	//a full chunk is replaced by a new one
+	check(arena_alloc(&arena, ARENA_CHUNK_SIZE - 16) == b + 8, "allocation doesn't fill the chunk");
+	uint8_t* next = arena_alloc(&arena, 8);
+	check(next != NULL && arena.chunkCount == 3, "no chunk allocated for a full chunk");
+
+	Arena_Stats stats;
+	arena_getStats(&arena, &stats);
+	check(stats.allocMem == 12 + aligned(ARENA_CHUNK_SIZE + 1) + 4 + ARENA_CHUNK_SIZE - 16 + 8, "allocated memory statistic is wrong");
+	check(stats.chunkMem == 2 * ARENA_CHUNK_SIZE + aligned(ARENA_CHUNK_SIZE + 1), "chunk memory statistic is wrong");
+
+	arena_release(&arena);
+	check(arena.chunkCount == 0 && arena.allocMem == 0 && heapFree() == initialFree, "release didn't return all chunks");
+
+	//the arena can be used again after release
+	check(arena_alloc(&arena, 4) != NULL, "allocation after release failed");
+	arena_release(&arena);
+	check(heapFree() == initialFree, "memory is lost");
+}
+
+static void testAttributes(void)
+{
+	Arena arena;
+	arena_init(&arena, "fast", 0, HEAP_ATTR_FAST);
+
+	//the fast region is the second section of the host memory map
+	const Device_MemorySection* section = &device_memoryMap[1];
+	uint8_t* mem = arena_alloc(&arena, 64);
+	check(mem >= (uint8_t*)section->start && mem <= (uint8_t*)section->end, "chunk has not the requested attributes");
+	mem = arena_alloc(&arena, 4 * ARENA_CHUNK_SIZE);
+	check(mem >= (uint8_t*)section->start && mem <= (uint8_t*)section->end, "dedicated chunk has not the requested attributes");
+	arena_release(&arena);
+}
+
+static void testMarker(void)
+{
+	size_t initialFree = heapFree();
+	Arena arena;
+	arena_init(&arena, "marker", 64, HEAP_ATTR_ANY);
+
+	//a marker of the empty arena releases everything
+	Arena_Marker empty;
+	arena_getMarker(&arena, &empty);
+	uint8_t* first = arena_alloc(&arena, 16);
+	arena_reset(&arena, &empty);
+	check(arena.chunkCount == 0 && heapFree() == initialFree, "reset to the empty arena kept chunks");
+
+	first = arena_alloc(&arena, 16);
+	Arena_Marker marker;
+	arena_getMarker(&arena, &marker);
+	size_t markerFree = heapFree();
+
+	//new chunks and dedicated chunks after the marker are freed, the position is restored
+	uint8_t* mem = arena_alloc(&arena, 16);
+	check(mem == first + 16, "allocation is not consecutive");
+	for (int i = 0; i < 8; i++)
+		check(arena_alloc(&arena, 40) != NULL, "allocation failed");
+	check(arena_alloc(&arena, 1000) != NULL, "allocation failed");
+	check(arena.chunkCount > 1, "no chunks allocated after the marker");
+
+	arena_reset(&arena, &marker);
+	check(arena.chunkCount == 1 && arena.allocMem == 16, "reset didn't restore the statistics");
+	check(heapFree() == markerFree, "reset didn't free the younger chunks");
+	check(arena_alloc(&arena, 16) == mem, "reset didn't restore the position");
+
+	arena_release(&arena);
+	check(heapFree() == initialFree, "memory is lost");
+}
+
+/********** randomized workload **********/
+
+static void checkArena(const Arena* arena)
+{
+	size_t allocMem = 0;
+	for (size_t i = 0; i < allocCount; i++)
+	{
+		const Allocation* alloc = &allocs[i];
+		for (size_t j = 0; j < alloc->size; j++)
+			check(alloc->mem[j] == alloc->pattern, "allocated memory was overwritten (overlapping allocations)");
+		allocMem += aligned(alloc->size);
+	}
+
+	Arena_Stats stats;
+	arena_getStats(arena, &stats);
+	check(stats.allocMem == allocMem, "allocated memory statistic is wrong");
+	check(stats.chunkCount == arena->chunkCount, "chunk count statistic is wrong");
+	check(stats.chunkMem >= stats.allocMem, "chunks hold less than the allocated memory");
+}
+
+static void randomOperation(Arena* arena)
+{
+	uint32_t type = nextRandom() % 16;
+
+	if (type == 0 && markerCount < MARKER_COUNT)
+	{
+		Marker* marker = &markers[markerCount++];
+		arena_getMarker(arena, &marker->marker);
+		marker->allocCount = allocCount;
+		marker->heapFree = heapFree();
+	}
+	else if (type == 1 && markerCount > 0)
+	{
+		//reset to a random marker, younger markers become invalid
+		markerCount = nextRandom() % markerCount;
+		const Marker* marker = &markers[markerCount];
+		arena_reset(arena, &marker->marker);
+		allocCount = marker->allocCount;
+		check(heapFree() == marker->heapFree, "reset didn't return the younger chunks");
+	}
+	else if (allocCount == ALLOC_COUNT)
+	{
+		arena_release(arena);
+		allocCount = 0;
+		markerCount = 0;
+	}
+	else
+	{
+		//mostly small allocations, some oversized ones
+		size_t size = (nextRandom() % 16 == 0) ? ARENA_CHUNK_SIZE + nextRandom() % 2048 : 1 + nextRandom() % 200;
+		Allocation* alloc = &allocs[allocCount];
+		alloc->mem = arena_alloc(arena, size);
+		check(alloc->mem != NULL && ((uintptr_t)alloc->mem & 3) == 0, "allocation failed or is not aligned");
+
+		alloc->size = size;
+		alloc->pattern = (uint8_t)nextRandom();
+		for (size_t i = 0; i < size; i++)
+			alloc->mem[i] = alloc->pattern;
+		allocCount++;
+	}
+}
+
+int main(void)
+{
+	heap_init();
+	size_t initialFree = heapFree();
+
+	testAlloc();
+	testAttributes();
+	testMarker();
+
+	Arena arena;
+	arena_init(&arena, "random", 0, HEAP_ATTR_ANY);
+	for (operation = 1; operation <= OPERATION_COUNT; operation++)
+	{
+		randomOperation(&arena);
+		if (operation <= FULL_CHECK_OPERATIONS || (operation % 64) == 0)
+			checkArena(&arena);
+	}
+
+	arena_release(&arena);
+	check(heapFree() == initialFree, "memory is lost");
+
+	hostio_printf("arenatest: %u operations passed\n", OPERATION_COUNT);
+	return 0;
+}
@@ -0,0 +1,279 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host test of the device table.
+ *
+ * dev.c is included, so the hash buckets can be checked after every operation of a randomized register/unregister workload:
+ * - every registered device is in the bucket of its name hash and number exactly once, no other device is in the table
+ * - dev_find finds every registered device and nothing else, also for names which only differ in a suffix
+ * - duplicate device names and invalid structures are rejected, unregistered devices can't be unregistered again
+ * Directed cases check the order of immediate and deferred events and synchronous reads through an asynchronous driver.
+ */
+
+#include "../../src/dev.c"
+#include "hostio.h"
+
+#define NAME_COUNT 8
+#define NUMBER_COUNT 24
+#define DEVICE_COUNT (NAME_COUNT*NUMBER_COUNT)
+#define OPERATION_COUNT 50000
+
+static const char* names[NAME_COUNT] = { "sd", "sda", "uart", "uart1", "dma", "null", "zero", "ram" };
+static Dev_Device devices[DEVICE_COUNT];
+static bool registered[DEVICE_COUNT];
+static uint32_t randomState = 1;
+static uint32_t operation;
+
+static uint32_t nextRandom(void)
+{
+	randomState = randomState * 1664525U + 1013904223U;
+	return randomState >> 8;
+}
+
+static void check(bool condition, const char* message)
+{
+	if (condition)
+		return;
+
+	hostio_printf("devtest: FAILED after operation %u: %s\n", operation, message);
+	hostio_exit(1);
+}
+
+static void initDevice(Dev_Device* device, const char* name, uint32_t number)
+{
+	*device = (Dev_Device){ .name = name, .number = number, .type = DEV_DEVICE_TYPE_CHAR };
+}
+
+/********** invariants **********/
+
+static void checkTable(void)
+{
+	size_t tableCount = 0;
+	for (size_t i = 0; i < DEV_HASH_TABLE_SIZE; i++)
+	{
+		for (const Dev_Device* device = deviceTable[i]; device != NULL; device = device->nextHash)
+		{
+			check(++tableCount <= DEVICE_COUNT, "device table contains a cycle");
+			check(device->nameHash == hashName(device->name), "name hash is wrong");
+			check(deviceBucket(device->nameHash, device->number) == &deviceTable[i], "device is in the wrong bucket");
+		}
+	}
+
+	size_t registeredCount = 0;
+	for (size_t i = 0; i < DEVICE_COUNT; i++)
+	{
+		Dev_Device* found = dev_find(devices[i].name, devices[i].number);
+		check(found == (registered[i] ? &devices[i] : NULL), "dev_find result is wrong");
+		registeredCount += registered[i] ? 1 : 0;
+	}
+	check(tableCount == registeredCount, "device table doesn't contain the registered devices");
+
+	check(dev_find("s", 0) == NULL && dev_find("sdb", 0) == NULL && dev_find("", 0) == NULL, "unknown name found");
+	check(dev_find("sd", NUMBER_COUNT) == NULL, "unknown number found");
+}
+
+/********** tests **********/
+
+static void testRegister(void)
+{
+	Dev_Device device, duplicate, invalid;
+	initDevice(&device, "test", 3);
+	initDevice(&duplicate, "test", 3);
+
+	check(dev_registerDevice(&device) == ERROR_NONE, "registration failed");
+	check(dev_find("test", 3) == &device, "registered device not found");
+	check(dev_registerDevice(&duplicate) == ERROR_DEV_DEVICE_NAME_EXISTS_ALREADY, "duplicate device name accepted");
+	check(dev_unregisterDevice(&duplicate) == ERROR_DEV_DEVICE_NOT_REGISTERED, "unregistered duplicate was unregistered");
+	check(dev_find("test", 3) == &device, "duplicate replaced the registered device");
+
+	initDevice(&invalid, NULL, 0);
+	check(dev_registerDevice(&invalid) == ERROR_DEV_INVALID_DEVICE_STRUCTURE, "device without name accepted");
+	initDevice(&invalid, "invalid", 0);
+	invalid.type = (DEV_DEVICE_TYPE)7;
+	check(dev_registerDevice(&invalid) == ERROR_DEV_INVALID_DEVICE_STRUCTURE, "invalid device type accepted");
+
+	check(dev_unregisterDevice(&device) == ERROR_NONE, "unregistration failed");
+	check(dev_find("test", 3) == NULL, "unregistered device found");
+	check(dev_unregisterDevice(&device) == ERROR_DEV_DEVICE_NOT_REGISTERED, "device unregistered twice");
+
+	//numbers which differ by the table size share a bucket, lookup must compare the number
+	Dev_Device low, high;
+	initDevice(&low, "chain", 1);
+	initDevice(&high, "chain", 1 + DEV_HASH_TABLE_SIZE);
+	check(dev_registerDevice(&low) == ERROR_NONE && dev_registerDevice(&high) == ERROR_NONE, "registration failed");
+	check(low.nextHash == NULL && high.nextHash == &low, "devices don't share a bucket");
+	check(dev_find("chain", 1) == &low && dev_find("chain", 1 + DEV_HASH_TABLE_SIZE) == &high, "device in a shared bucket not found");
+	check(dev_unregisterDevice(&low) == ERROR_NONE && dev_find("chain", 1 + DEV_HASH_TABLE_SIZE) == &high, "unregistration broke the bucket");
+	check(dev_unregisterDevice(&high) == ERROR_NONE, "unregistration failed");
+
+	//the name is free again
+	check(dev_registerDevice(&duplicate) == ERROR_NONE && dev_find("test", 3) == &duplicate, "name can't be registered again");
+	check(dev_unregisterDevice(&duplicate) == ERROR_NONE, "unregistration failed");
+}
+
+static char eventLog[16];
+static size_t eventLogCount;
+
+static void logEvent(char c)
+{
+	check(eventLogCount < sizeof(eventLog) - 1, "too many events");
+	eventLog[eventLogCount++] = c;
+	eventLog[eventLogCount] = '\0';
+}
+
+static void immediateHandler(Dev_Device* device, DEV_DEVICE_EVENT event)
+{
+	//unregistration events arrive while the device can still be found
+	check(dev_find(device->name, device->number) == device, "device of an immediate event can't be found");
+	logEvent(event == DEV_DEVICE_EVENT_REGISTERED ? 'R' : 'U');
+}
+
+static void deferredHandler(Dev_Device* device, DEV_DEVICE_EVENT event)
+{
+	logEvent(event == DEV_DEVICE_EVENT_REGISTERED ? 'r' : 'u');
+}
+
+static void testEvents(void)
+{
+	Dev_Device a, b;
+	initDevice(&a, "event", 0);
+	initDevice(&b, "event", 1);
+	eventLogCount = 0;
+	eventLog[0] = '\0';
+
+	check(dev_registerEventHandler(immediateHandler) == ERROR_NONE, "handler registration failed");
+	check(dev_registerDeferredEventHandler(deferredHandler) == ERROR_NONE, "handler registration failed");
+	check(dev_registerEventHandler(NULL) == ERROR_INVALID_ADDRESS, "NULL handler accepted");
+
+	//immediate handlers are called at once, deferred handlers by the work queue in the order of the events
+	dev_registerDevice(&a);
+	dev_registerDevice(&b);
+	dev_unregisterDevice(&a);
+	check(util_strcmp(eventLog, "RRU") == 0 && pendingEvents == 3, "immediate events are wrong");
+	check(host_basepri == 0, "critical section left open");
+	workq_run();
+	check(util_strcmp(eventLog, "RRUrru") == 0 && pendingEvents == 0, "deferred events are wrong");
+
+	check(dev_unregisterEventHandler(immediateHandler) == ERROR_NONE, "handler unregistration failed");
+	check(dev_unregisterEventHandler(immediateHandler) == ERROR_DEV_HANDLER_NOT_REGISTERED, "handler unregistered twice");
+	check(dev_unregisterEventHandler(deferredHandler) == ERROR_NONE, "handler unregistration failed");
+	dev_unregisterDevice(&b);
+	workq_run();
+	check(util_strcmp(eventLog, "RRUrru") == 0, "unregistered handlers were called");
+}
+
+//asynchronous driver: requests are completed by the emulated interrupt while the caller waits
+static Dev_Request* pendingRequest;
+
+static error_t asyncSubmit(Dev_Device* device, Dev_Request* request)
+{
+	check(pendingRequest == NULL, "driver got a second request");
+	pendingRequest = request;
+	return ERROR_NONE;
+}
+
+static void completeInterrupt(void)
+{
+	Dev_Request* request = pendingRequest;
+	check(request != NULL, "caller waits without a pending request");
+	pendingRequest = NULL;
+
+	uint8_t* buf = request->buf;
+	for (size_t i = 0; i < request->size; i++)
+		buf[i] = (uint8_t)(request->offset + i);
+	dev_completeRequest(request, request->size, ERROR_NONE);
+}
+
+static void testSyncRead(void)
+{
+	Dev_Device device;
+	initDevice(&device, "async", 0);
+	device.type = DEV_DEVICE_TYPE_BLOCK;
+	device.submit = asyncSubmit;
+	check(dev_registerDevice(&device) == ERROR_NONE, "registration failed");
+
+	uint8_t buf[16];
+	host_waitHook = completeInterrupt;
+	check(dev_read(&device, buf, sizeof(buf), 32) == sizeof(buf), "synchronous read through submit failed");
+	host_waitHook = NULL;
+	for (size_t i = 0; i < sizeof(buf); i++)
+		check(buf[i] == 32 + i, "synchronous read returned wrong data");
+
+	check(dev_write(&device, NULL, sizeof(buf), 0) == 0, "write without buffer succeeded");
+	dev_unregisterDevice(&device);
+}
+
+static void randomOperation(void)
+{
+	size_t index = nextRandom() % DEVICE_COUNT;
+	Dev_Device* device = &devices[index];
+
+	if (!registered[index])
+	{
+		check(dev_registerDevice(device) == ERROR_NONE, "registration failed");
+		registered[index] = true;
+	}
+	else if ((nextRandom() & 7) == 0)
+	{
+		//a second structure with the same name must be rejected
+		Dev_Device duplicate;
+		initDevice(&duplicate, device->name, device->number);
+		check(dev_registerDevice(&duplicate) == ERROR_DEV_DEVICE_NAME_EXISTS_ALREADY, "duplicate device name accepted");
+	}
+	else
+	{
+		check(dev_unregisterDevice(device) == ERROR_NONE, "unregistration failed");
+		check(dev_unregisterDevice(device) == ERROR_DEV_DEVICE_NOT_REGISTERED, "device unregistered twice");
+		registered[index] = false;
+	}
+}
+
+int main(void)
+{
+	heap_init();
+	workq_init();
+	dev_init();
+
+	for (size_t i = 0; i < DEVICE_COUNT; i++)
+		initDevice(&devices[i], names[i % NAME_COUNT], i / NAME_COUNT);
+	checkTable();
+
+	testRegister();
+	testEvents();
+	testSyncRead();
+	checkTable();
+
+	for (operation = 1; operation <= OPERATION_COUNT; operation++)
+	{
+		randomOperation();
+		checkTable();
+	}
+
+	//deinitialization unregisters the remaining devices
+	dev_deinit();
+	for (size_t i = 0; i < DEV_HASH_TABLE_SIZE; i++)
+		check(deviceTable[i] == NULL, "device table is not empty after deinitialization");
+
+	hostio_printf("devtest: %u operations passed\n", OPERATION_COUNT);
+	return 0;
+}
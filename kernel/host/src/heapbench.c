@@ -0,0 +1,191 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host benchmark of the TLSF heap against the first-fit allocator it replaced.
+ *
+ * Both allocators run the same generated traces. The TLSF heap manages the emulated memory map (SRAM and CCM),
+ * the first-fit allocator gets one block of the same total size. Latencies include the overhead of the host clock.
+ */
+
+#include <heap.h>
+#include "firstfit.h"
+#include "hostio.h"
+#include "latency.h"
+
+#define SLOT_COUNT 1024
+#define OPERATION_COUNT 400000
+#define FIRSTFIT_HEAP_SIZE ((128+64)*1024)
+
+typedef struct Operation
+{
+	uint16_t slot;	//slot of the block
+	uint32_t size;	//size of allocation (0 frees the block of the slot)
+} Operation;
+
+typedef struct Allocator
+{
+	const char* name;
+	void (*init)(void);
+	void* (*alloc)(size_t size);
+	void (*free)(void* mem);
+} Allocator;
+
+static Operation operations[OPERATION_COUNT];
+static void* slots[SLOT_COUNT];
+static uint8_t firstfitHeap[FIRSTFIT_HEAP_SIZE] __attribute__((aligned(8)));
+static Latency allocLatency, freeLatency;
+static uint32_t randomState;
+
+static uint32_t nextRandom(void)
+{
+	randomState = randomState * 1664525U + 1013904223U;
+	return randomState >> 8;
+}
+
+/********** allocators **********/
+
+static void tlsfInit(void)
+{
+	heap_init();
+}
+
+static void firstfitInit(void)
+{
+	firstfit_init(firstfitHeap, FIRSTFIT_HEAP_SIZE);
+}
+
+static const Allocator allocators[] =
+{
+	{ "tlsf", tlsfInit, heap_alloc, heap_free },
+	{ "firstfit", firstfitInit, firstfit_alloc, firstfit_free }
+};
+
+/********** traces **********/
+
+/* Random sizes (90% 8-256 bytes, 10% up to 4 KiB), every slot alternates between allocation and free */
+static void generateMixed(void)
+{
+	bool used[SLOT_COUNT] = { false };
+	randomState = 1;
+	for (size_t i = 0; i < OPERATION_COUNT; i++)
+	{
+		uint16_t slot = nextRandom() % SLOT_COUNT;
+		uint32_t size = 0;
+		if (!used[slot])
+			size = (nextRandom() % 10 != 0) ? 8 + nextRandom() % 249 : 256 + nextRandom() % 3841;
+
+		used[slot] = !used[slot];
+		operations[i].slot = slot;
+		operations[i].size = size;
+	}
+}
+
+/* Long-lived small blocks (rarely freed) interleaved with short-lived large buffers, fragments the heap over time */
+static void generateFragmenting(void)
+{
+	bool used[SLOT_COUNT] = { false };
+	randomState = 2;
+	for (size_t i = 0; i < OPERATION_COUNT; )
+	{
+		uint16_t slot;
+		uint32_t size = 0;
+		if (nextRandom() % 4 == 0)
+		{
+			//large buffer slots (last 1/16 of the slots)
+			slot = SLOT_COUNT - SLOT_COUNT / 16 + nextRandom() % (SLOT_COUNT / 16);
+			if (!used[slot])
+				size = 512 + nextRandom() % 2561;
+		}
+		else
+		{
+			//small object slots, only freed with a probability of 1/8
+			slot = nextRandom() % (SLOT_COUNT - SLOT_COUNT / 16);
+			if (used[slot] && nextRandom() % 8 != 0)
+				continue;
+			if (!used[slot])
+				size = 16 + nextRandom() % 113;
+		}
+
+		used[slot] = !used[slot];
+		operations[i].slot = slot;
+		operations[i].size = size;
+		i++;
+	}
+}
+
+/********** benchmark **********/
+
+static void run(const Allocator* allocator, size_t operationCount)
+{
+	allocator->init();
+	for (size_t i = 0; i < SLOT_COUNT; i++)
+		slots[i] = NULL;
+	latency_init(&allocLatency);
+	latency_init(&freeLatency);
+
+	uint32_t failCount = 0;
+	for (size_t i = 0; i < operationCount; i++)
+	{
+		const Operation* operation = &operations[i];
+		uint64_t start = hostio_nanoseconds();
+		if (operation->size != 0)
+		{
+			slots[operation->slot] = allocator->alloc(operation->size);
+			latency_add(&allocLatency, hostio_nanoseconds() - start);
+			if (slots[operation->slot] == NULL)
+				failCount++;
+		}
+		else
+		{
+			allocator->free(slots[operation->slot]);
+			latency_add(&freeLatency, hostio_nanoseconds() - start);
+			slots[operation->slot] = NULL;
+		}
+	}
+
+	hostio_printf(" %s (%u failed allocations)\n", allocator->name, failCount);
+	latency_print("alloc", &allocLatency);
+	latency_print("free", &freeLatency);
+
+	for (size_t i = 0; i < SLOT_COUNT; i++)
+		allocator->free(slots[i]);
+}
+
+int main(void)
+{
+	static const struct
+	{
+		const char* name;
+		void (*generate)(void);
+	} traces[] = { { "mixed", generateMixed }, { "fragmenting", generateFragmenting } };
+
+	for (size_t t = 0; t < sizeof(traces) / sizeof(traces[0]); t++)
+	{
+		traces[t].generate();
+		hostio_printf("trace %s, %u operations\n", traces[t].name, OPERATION_COUNT);
+		for (size_t a = 0; a < sizeof(allocators) / sizeof(allocators[0]); a++)
+			run(&allocators[a], OPERATION_COUNT);
+	}
+
+	return 0;
+}
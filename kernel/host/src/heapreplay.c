@@ -0,0 +1,356 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host replay of allocation traces recorded with HEAPTRACE (see heap_dumpTrace).
+ *
+ * The dump is read from stdin, lines without "heaptrace" (other debug output) are ignored. Every entry is replayed
+ * against heap.c on the emulated memory map, recorded addresses are mapped to the addresses of the replay.
+ * Pool refills and deferred frees (blocks of interrupt handlers) are replayed as allocations and frees in thread mode,
+ * movable blocks are mapped by their handles (pins aren't recorded, so the replay can move every movable block).
+ * The replay reports the latency percentiles of every operation type, the peak footprint and the fragmentation.
+ *
+ * Usage: bin/heapreplay < trace.txt (or make replay TRACE=trace.txt)
+ */
+
+#include <heap.h>
+#include <util.h>
+#include "hostio.h"
+#include "latency.h"
+
+#define LINE_SIZE 256
+#define FIELD_COUNT 8
+#define ADDRESS_MAP_SIZE 16384	//must be a power of 2 and greater than the number of live blocks of a trace
+
+typedef struct AddressEntry
+{
+	uint32_t recorded;	//address of the recorded trace (0 if entry is unused)
+	void* mem;			//address of the replay
+} AddressEntry;
+
+/* Entry types in the order of the type names of the dump (HEAP_TRACE_TYPE is only defined in HEAPTRACE builds) */
+typedef enum REPLAY_TYPE
+{
+	REPLAY_ALLOC,
+	REPLAY_ALIGNED,
+	REPLAY_REALLOC,
+	REPLAY_FREE,
+	REPLAY_POOL_ALLOC,
+	REPLAY_DEFERRED_FREE,
+	REPLAY_ALLOC_MOVABLE,
+	REPLAY_FREE_MOVABLE,
+	REPLAY_COMPACT,
+	REPLAY_TYPE_COUNT
+} REPLAY_TYPE;
+
+static AddressEntry addressMap[ADDRESS_MAP_SIZE];
+static size_t addressCount;
+static Latency latencies[REPLAY_TYPE_COUNT];
+static const char* typeNames[REPLAY_TYPE_COUNT] = { "alloc", "aligned", "realloc", "free", "poolalloc", "deferredfree", "movable", "freemovable", "compact" };
+
+/********** address map **********/
+
+static size_t addressSlot(uint32_t recorded)
+{
+	return (recorded * 2654435761U) & (ADDRESS_MAP_SIZE - 1);
+}
+
+static void* addressFind(uint32_t recorded)
+{
+	for (size_t i = addressSlot(recorded); addressMap[i].recorded != 0; i = (i + 1) & (ADDRESS_MAP_SIZE - 1))
+	{
+		if (addressMap[i].recorded == recorded)
+			return addressMap[i].mem;
+	}
+
+	return NULL;
+}
+
+static bool addressAdd(uint32_t recorded, void* mem)
+{
+	if (recorded == 0 || mem == NULL || addressCount >= ADDRESS_MAP_SIZE - 1)
+		return false;
+
+	size_t i = addressSlot(recorded);
+	while (addressMap[i].recorded != 0 && addressMap[i].recorded != recorded)
+		i = (i + 1) & (ADDRESS_MAP_SIZE - 1);
+
+	if (addressMap[i].recorded == 0)
+		addressCount++;
+	addressMap[i].recorded = recorded;
+	addressMap[i].mem = mem;
+	return true;
+}
+
+static void addressRemove(uint32_t recorded)
+{
+	size_t i = addressSlot(recorded);
+	while (addressMap[i].recorded != recorded)
+	{
+		if (addressMap[i].recorded == 0)
+			return;
+		i = (i + 1) & (ADDRESS_MAP_SIZE - 1);
+	}
+
+	//shift following entries of the probe sequence back, so no lookup ends at the removed entry
+	size_t hole = i;
+	for (size_t j = (i + 1) & (ADDRESS_MAP_SIZE - 1); addressMap[j].recorded != 0; j = (j + 1) & (ADDRESS_MAP_SIZE - 1))
+	{
+		size_t home = addressSlot(addressMap[j].recorded);
+		if (((j - home) & (ADDRESS_MAP_SIZE - 1)) >= ((j - hole) & (ADDRESS_MAP_SIZE - 1)))
+		{
+			addressMap[hole] = addressMap[j];
+			hole = j;
+		}
+	}
+
+	addressMap[hole].recorded = 0;
+	addressCount--;
+}
+
+/********** parser **********/
+
+static const char* findToken(const char* line, const char* token)
+{
+	size_t length = util_strlen(token);
+	for (; *line != '\0'; line++)
+	{
+		size_t i = 0;
+		while (i < length && line[i] == token[i])
+			i++;
+		if (i == length)
+			return line + length;
+	}
+
+	return NULL;
+}
+
+static const char* skipSpaces(const char* str)
+{
+	while (*str == ' ' || *str == '\t')
+		str++;
+	return str;
+}
+
+/* Parse a word, returns the position behind it */
+static const char* parseWord(const char* str, char* word, size_t size)
+{
+	size_t i = 0;
+	str = skipSpaces(str);
+	while (*str != '\0' && *str != ' ' && *str != '\t')
+	{
+		if (i + 1 < size)
+			word[i++] = *str;
+		str++;
+	}
+
+	word[i] = '\0';
+	return str;
+}
+
+/* Parse a hexadecimal number, returns NULL if there is none */
+static const char* parseHex(const char* str, uint32_t* value)
+{
+	str = skipSpaces(str);
+	if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+		str += 2;
+
+	uint32_t result = 0;
+	const char* start = str;
+	for (;; str++)
+	{
+		uint32_t digit;
+		if (*str >= '0' && *str <= '9')
+			digit = *str - '0';
+		else if (*str >= 'a' && *str <= 'f')
+			digit = *str - 'a' + 10;
+		else if (*str >= 'A' && *str <= 'F')
+			digit = *str - 'A' + 10;
+		else
+			break;
+		result = (result << 4) | digit;
+	}
+
+	*value = result;
+	return (str != start) ? str : NULL;
+}
+
+static int parseType(const char* word)
+{
+	for (int type = 0; type < REPLAY_TYPE_COUNT; type++)
+	{
+		if (util_strcmp(word, typeNames[type]) == 0)
+			return type;
+	}
+
+	return -1;
+}
+
+/********** replay **********/
+
+typedef struct Replay
+{
+	uint32_t entryCount;		//number of replayed entries
+	uint32_t lostCount;			//number of entries which were overwritten in the ring buffer before the dump
+	uint32_t unknownCount;		//number of entries which reference a block allocated before the trace (skipped)
+	uint32_t failCount;			//number of allocations which failed in the replay, but succeeded in the recording
+	uint32_t peakFragmentation;	//highest fragmentation index during the replay
+	size_t liveMem;				//allocated memory at the peak of the replay (without heap control structures)
+} Replay;
+
+static void replayEntry(Replay* replay, int type, const uint32_t* fields)
+{
+	//fields: timestamp cycles caller size arg mem oldMem
+	size_t size = fields[3];
+	uint32_t arg = fields[4];
+	uint32_t recordedMem = fields[5];
+	uint32_t recordedOldMem = fields[6];
+
+	//movable blocks are identified by their handles (stable across compaction), handles and block addresses share the map
+	bool frees = (type == REPLAY_FREE || type == REPLAY_DEFERRED_FREE || type == REPLAY_FREE_MOVABLE);
+	bool allocates = (type != REPLAY_COMPACT && !frees);
+
+	//blocks allocated before the first entry are unknown
+	void* oldMem = NULL;
+	if ((type == REPLAY_REALLOC || frees) && recordedOldMem != 0)
+	{
+		oldMem = addressFind(recordedOldMem);
+		if (oldMem == NULL)
+		{
+			replay->unknownCount++;
+			return;
+		}
+	}
+
+	void* mem = NULL;
+	uint64_t start = hostio_nanoseconds();
+	switch (type)
+	{
+		case REPLAY_ALLOC:
+			mem = heap_allocAttr(size, arg);
+			break;
+		case REPLAY_ALIGNED:
+			mem = heap_allocAligned(size, arg >> 16, arg & 0xFFFF);
+			break;
+		case REPLAY_REALLOC:
+			mem = heap_realloc(oldMem, size);
+			break;
+		case REPLAY_FREE:
+		case REPLAY_DEFERRED_FREE:
+			heap_free(oldMem);
+			break;
+		case REPLAY_POOL_ALLOC:
+			mem = heap_allocAttr(size, arg);
+			break;
+		case REPLAY_ALLOC_MOVABLE:
+			mem = heap_allocMovable(size, arg);
+			break;
+		case REPLAY_FREE_MOVABLE:
+			heap_freeMovable(oldMem);
+			break;
+		case REPLAY_COMPACT:
+			heap_compact();
+			break;
+	}
+	latency_add(&latencies[type], hostio_nanoseconds() - start);
+	replay->entryCount++;
+
+	//a failed realloc keeps the old block, a realloc with size 0 frees it
+	if (frees || (type == REPLAY_REALLOC && (mem != NULL || size == 0)))
+		addressRemove(recordedOldMem);
+
+	if (allocates && recordedMem != 0)
+	{
+		if (mem == NULL)
+			replay->failCount++;
+		else if (!addressAdd(recordedMem, mem))
+			hostio_printf("heapreplay: address map is full, block %x is not tracked\n", recordedMem);
+	}
+}
+
+int main(void)
+{
+	heap_init();
+	Heap_Stats stats;
+	heap_getDetailedStats(&stats);
+	size_t baseMem = stats.allocMem;
+
+	Replay replay = { 0, 0, 0, 0, 0, 0 };
+	for (int type = 0; type < REPLAY_TYPE_COUNT; type++)
+		latency_init(&latencies[type]);
+
+	char line[LINE_SIZE];
+	while (hostio_readLine(line, sizeof(line)))
+	{
+		const char* str = findToken(line, "heaptrace ");
+		if (str == NULL)
+			continue;
+
+		char word[16];
+		str = parseWord(str, word, sizeof(word));
+		if (util_strcmp(word, "begin") == 0)
+		{
+			uint32_t first;
+			if (parseHex(str, &first) != NULL)
+				replay.lostCount += first;
+			continue;
+		}
+
+		int type = parseType(word);
+		if (type < 0)
+			continue;
+
+		uint32_t fields[FIELD_COUNT - 1];
+		bool valid = true;
+		for (int i = 0; i < FIELD_COUNT - 1 && valid; i++)
+		{
+			str = parseHex(str, &fields[i]);
+			valid = (str != NULL);
+		}
+		if (!valid)
+		{
+			hostio_printf("heapreplay: invalid entry \"%s\"\n", line);
+			continue;
+		}
+
+		replayEntry(&replay, type, fields);
+
+		heap_getDetailedStats(&stats);
+		if (stats.fragmentation > replay.peakFragmentation)
+			replay.peakFragmentation = stats.fragmentation;
+	}
+
+	heap_getDetailedStats(&stats);
+	hostio_printf("heapreplay: %u entries replayed (%u lost before the dump, %u skipped with unknown blocks, %u failed allocations)\n",
+			replay.entryCount, replay.lostCount, replay.unknownCount, replay.failCount);
+	for (int type = 0; type < REPLAY_TYPE_COUNT; type++)
+	{
+		if (latencies[type].count != 0)
+			latency_print(typeNames[type], &latencies[type]);
+	}
+	hostio_printf(" peak footprint %u bytes (heap %u bytes, %u bytes control structures)\n",
+			(uint32_t)(stats.peakAllocMem - baseMem), (uint32_t)stats.heapSize, (uint32_t)baseMem);
+	hostio_printf(" fragmentation %u per mille at end (peak %u), %u free blocks, largest %u bytes, %u live blocks\n",
+			stats.fragmentation, replay.peakFragmentation, (uint32_t)stats.freeBlockCount, (uint32_t)stats.largestFreeBlock, (uint32_t)addressCount);
+
+	return 0;
+}
@@ -0,0 +1,538 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host test of the TLSF heap.
+ *
+ * heap.c is included, so the internal structures can be checked after the operations of a randomized workload:
+ * - the physical blocks of every region tile the region up to the sentinel block, flags and footers are consistent
+ * - no two free blocks are adjacent (freed blocks are coalesced)
+ * - every free block is in the free list of its size class, every list entry is a free block of this class
+ * - the first and second level bitmaps match the free lists, the statistics match the blocks
+ * - allocated memory doesn't overlap (every allocation is filled with a pattern which is verified)
+ * - moving reallocations keep the requested attributes, but aren't bound to the region of the old block
+ * - owner accounting follows blocks through reallocation, reassignment and free
+ * - interrupt allocations use the smallest suitable pool, frees in handler mode are deferred until the next call in thread mode
+ * - compaction moves unpinned movable blocks down and keeps their content, pinned blocks stay in place
+ */
+
+#include "../../src/heap.c"
+#include "hostio.h"
+
+#define SLOT_COUNT 256
+#define OPERATION_COUNT 200000
+#define FULL_CHECK_OPERATIONS 20000	//check after every operation until then, afterwards after every 64th operation
+
+typedef struct Slot
+{
+	uint8_t* mem;		//allocated memory (NULL if slot is unused)
+	size_t size;		//requested size
+	uint8_t pattern;	//fill byte
+} Slot;
+
+static Slot slots[SLOT_COUNT];
+static uint32_t randomState = 1;
+static uint32_t operation;
+
+static uint32_t nextRandom(void)
+{
+	randomState = randomState * 1664525U + 1013904223U;
+	return randomState >> 8;
+}
+
+static void check(bool condition, const char* message)
+{
+	if (condition)
+		return;
+
+	hostio_printf("heaptest: FAILED after operation %u: %s\n", operation, message);
+	hostio_exit(1);
+}
+
+/********** invariants **********/
+
+static bool isInFreeList(const HeapRegion* region, const MemoryNode* block)
+{
+	uint32_t fl, sl;
+	mappingInsert(blockSize(block), &fl, &sl);
+
+	for (const MemoryNode* node = region->freeLists[fl][sl]; node != NULL; node = node->nextFree)
+	{
+		if (node == block)
+			return true;
+	}
+
+	return false;
+}
+
+static void checkRegion(const HeapRegion* region)
+{
+	//physical blocks
+	size_t freeSize = 0, freeCount = 0;
+	bool prevFree = false;
+	const MemoryNode* block = (const MemoryNode*)(region->start + sizeof(HeapRegion));
+	for (;;)
+	{
+		check((const uint8_t*)block + BLOCK_HEADER_SIZE <= region->end, "block outside of region");
+		check(((uintptr_t)block & BLOCK_FLAGS_MSK) == 0, "block not aligned");
+		check(blockIsPrevFree(block) == prevFree, "predecessor free flag is wrong");
+
+		size_t size = blockSize(block);
+		if (size == 0)
+		{
+			check(!blockIsFree(block), "sentinel block is free");
+			check((const uint8_t*)block + BLOCK_HEADER_SIZE == region->end, "blocks don't reach the region end");
+			break;
+		}
+		check(size >= BLOCK_SIZE_MIN, "block is smaller than the minimum block size");
+
+		if (blockIsFree(block))
+		{
+			check(!prevFree, "adjacent free blocks are not coalesced");
+			check(*((MemoryNode**)blockNextPhys(block) - 1) == block, "footer of free block is wrong");
+			check(isInFreeList(region, block), "free block is not in its free list");
+			check(blockOwner(block) == HEAP_OWNER_NONE, "free block has an owner");
+			check(blockAttributes(block) == HEAP_ATTR_ANY, "free block has attributes");
+			freeSize += size;
+			freeCount++;
+		}
+
+		prevFree = blockIsFree(block);
+		block = blockNextPhys(block);
+	}
+	check(freeSize == region->freeMem, "free memory statistic is wrong");
+	check(freeCount == region->freeBlockCount, "free block count is wrong");
+
+	//free lists and bitmaps
+	size_t listCount = 0;
+	check((region->flBitmap >> FL_INDEX_COUNT) == 0, "first level bitmap has bits beyond the last class");
+	for (uint32_t fl = 0; fl < FL_INDEX_COUNT; fl++)
+	{
+		check(((region->flBitmap >> fl) & 1) == (region->slBitmap[fl] != 0), "first level bitmap doesn't match second level bitmap");
+		for (uint32_t sl = 0; sl < SL_INDEX_COUNT; sl++)
+		{
+			const MemoryNode* node = region->freeLists[fl][sl];
+			check(((region->slBitmap[fl] >> sl) & 1) == (node != NULL), "second level bitmap doesn't match free list");
+
+			const MemoryNode* prev = NULL;
+			for (; node != NULL; prev = node, node = node->nextFree)
+			{
+				check(++listCount <= freeCount, "free lists contain more blocks than the region");
+				check((const uint8_t*)node >= region->start + sizeof(HeapRegion) && (const uint8_t*)node < region->end, "free list entry outside of region");
+				check(blockIsFree(node), "free list entry is not free");
+				check(node->prevFree == prev, "free list back link is wrong");
+
+				uint32_t nodeFl, nodeSl;
+				mappingInsert(blockSize(node), &nodeFl, &nodeSl);
+				check(nodeFl == fl && nodeSl == sl, "free list entry has the wrong size class");
+			}
+		}
+	}
+	check(listCount == freeCount, "free lists contain fewer blocks than the region");
+}
+
+static void checkSlot(const Slot* slot)
+{
+	for (size_t i = 0; i < slot->size; i++)
+		check(slot->mem[i] == slot->pattern, "allocated memory was overwritten (overlapping blocks)");
+}
+
+static void checkHeap(void)
+{
+	size_t totalFree = 0;
+	for (size_t i = 0; i < regionCount; i++)
+	{
+		checkRegion(regions[i]);
+		totalFree += regions[i]->freeMem;
+	}
+	check(totalFree == freeMem, "heap free memory statistic is wrong");
+
+	for (size_t i = 0; i < SLOT_COUNT; i++)
+	{
+		if (slots[i].mem != NULL)
+			checkSlot(&slots[i]);
+	}
+}
+
+/********** workload **********/
+
+static void fillSlot(Slot* slot, void* mem, size_t size)
+{
+	slot->mem = mem;
+	slot->size = size;
+	slot->pattern = (uint8_t)nextRandom();
+	for (size_t i = 0; i < size; i++)
+		slot->mem[i] = slot->pattern;
+}
+
+static size_t randomSize(void)
+{
+	//mostly small blocks, some large ones
+	uint32_t r = nextRandom();
+	if ((r & 0xF) == 0)
+		return 1 + (nextRandom() % 8192);
+	return 1 + (nextRandom() % 256);
+}
+
+static void randomOperation(void)
+{
+	Slot* slot = &slots[nextRandom() % SLOT_COUNT];
+	uint32_t type = nextRandom() % 8;
+
+	if (slot->mem == NULL)
+	{
+		size_t size = randomSize();
+		void* mem;
+		if (type == 0)
+		{
+			uint32_t attributes = (nextRandom() & 1) ? HEAP_ATTR_FAST : HEAP_ATTR_DMA;
+			mem = heap_allocAttr(size, attributes);
+			check(mem == NULL || (findRegion(mem)->attributes & attributes) == attributes, "memory has not the requested attributes");
+		}
+		else if (type == 1)
+		{
+			uint32_t alignLog2 = 3 + nextRandom() % 6;
+			mem = heap_allocAligned(size, alignLog2, HEAP_ATTR_ANY);
+			check(((uintptr_t)mem & ((1U << alignLog2) - 1)) == 0, "memory is not aligned");
+		}
+		else
+		{
+			mem = heap_alloc(size);
+		}
+
+		if (mem != NULL)
+		{
+			check(blockSize(memToBlock(mem)) >= size + BLOCK_HEADER_SIZE, "block is smaller than requested");
+			fillSlot(slot, mem, size);
+		}
+	}
+	else if (type < 2)
+	{
+		//content must be kept up to the smaller size
+		checkSlot(slot);
+		size_t size = randomSize();
+		uint8_t* mem = heap_realloc(slot->mem, size);
+		if (mem != NULL)
+		{
+			for (size_t i = 0; i < size && i < slot->size; i++)
+				check(mem[i] == slot->pattern, "realloc didn't keep the content");
+			fillSlot(slot, mem, size);
+		}
+	}
+	else
+	{
+		checkSlot(slot);
+		heap_free(slot->mem);
+		slot->mem = NULL;
+	}
+}
+
+static void testCoalescing(void)
+{
+	size_t initialFree = freeMem;
+
+	//three neighbouring blocks, freed in the order middle, first, last
+	uint8_t* a = heap_alloc(100);
+	uint8_t* b = heap_alloc(100);
+	uint8_t* c = heap_alloc(100);
+	check(a != NULL && b != NULL && c != NULL, "allocation failed");
+	check(blockNextPhys(memToBlock(a)) == memToBlock(b) && blockNextPhys(memToBlock(b)) == memToBlock(c), "blocks are not neighbours");
+
+	heap_free(b);
+	checkHeap();
+	heap_free(a);
+	checkHeap();
+	check(blockIsFree(memToBlock(a)) && blockSize(memToBlock(a)) >= 2 * 100, "first and middle block are not merged");
+	heap_free(c);
+	checkHeap();
+
+	check(freeMem == initialFree, "memory is lost");
+	for (size_t i = 0; i < regionCount; i++)
+		check(regions[i]->freeBlockCount == 1, "region is not one free block again");
+}
+
+static void testReallocMove(void)
+{
+	size_t initialFree = freeMem;
+
+	//small blocks are placed in the fast region, a block without required attributes can move to any region
+	uint8_t* mem = heap_alloc(64);
+	check(mem != NULL && (findRegion(mem)->attributes & HEAP_ATTR_FAST) != 0, "small block is not in the fast region");
+	mem = heap_realloc(mem, 70000);
+	check(mem != NULL && (findRegion(mem)->attributes & HEAP_ATTR_FAST) == 0, "block can't move to another region");
+	heap_free(mem);
+	checkHeap();
+
+	//a block with required attributes only moves to regions which provide them
+	mem = heap_allocAttr(64, HEAP_ATTR_FAST);
+	check(mem != NULL, "allocation failed");
+	check(heap_realloc(mem, 70000) == NULL, "block moved to a region without the requested attributes");
+	uint8_t* dmaMem = heap_allocAttr(64, HEAP_ATTR_DMA);
+	check(dmaMem != NULL, "allocation failed");
+	dmaMem = heap_realloc(dmaMem, 70000);
+	check(dmaMem != NULL && (findRegion(dmaMem)->attributes & HEAP_ATTR_DMA) != 0, "moved block lost the requested attributes");
+	heap_free(dmaMem);
+	heap_free(mem);
+	checkHeap();
+
+	check(freeMem == initialFree, "memory is lost");
+}
+
+static void fillMovable(Heap_Handle handle, size_t size, uint8_t pattern)
+{
+	uint8_t* mem = heap_pin(handle);
+	for (size_t i = 0; i < size; i++)
+		mem[i] = pattern;
+	heap_unpin(handle);
+}
+
+static void checkMovable(Heap_Handle handle, size_t size, uint8_t pattern)
+{
+	const uint8_t* mem = heap_pin(handle);
+	for (size_t i = 0; i < size; i++)
+		check(mem[i] == pattern, "movable memory lost its content");
+	heap_unpin(handle);
+}
+
+static void testCompaction(void)
+{
+	size_t initialFree = freeMem;
+	Heap_Stats stats;
+	heap_getDetailedStats(&stats);
+	size_t initialMoved = stats.movedMem;
+
+	//a fixed block followed by three movable blocks, the fixed block is freed to leave a hole
+	uint8_t* hole = heap_alloc(100);
+	Heap_Handle a = heap_allocMovable(200, HEAP_ATTR_ANY);
+	Heap_Handle b = heap_allocMovable(300, HEAP_ATTR_ANY);
+	Heap_Handle c = heap_allocMovable(400, HEAP_ATTR_ANY);
+	check(hole != NULL && a != NULL && b != NULL && c != NULL, "allocation failed");
+	check(blockNextPhys(memToBlock(hole)) == a->block && blockNextPhys(a->block) == b->block && blockNextPhys(b->block) == c->block, "blocks are not neighbours");
+	fillMovable(a, 200, 0xA1);
+	fillMovable(b, 300, 0xB2);
+	fillMovable(c, 400, 0xC3);
+
+	MemoryNode* holeBlock = memToBlock(hole);
+	MemoryNode* pinnedBlock = c->block;
+	size_t expectedMoved = blockSize(a->block) + blockSize(b->block);
+	heap_free(hole);
+
+	//pinned blocks stay in place, the others move down into the hole
+	heap_pin(c);
+	size_t moved = heap_compact();
+	checkHeap();
+	check(moved == expectedMoved, "compaction moved the wrong number of bytes");
+	check(a->block == holeBlock && blockNextPhys(a->block) == b->block, "movable blocks were not moved down");
+	check(c->block == pinnedBlock, "pinned block was moved");
+	check(blockIsFree(blockNextPhys(b->block)) && blockNextPhys(blockNextPhys(b->block)) == c->block, "hole is not behind the moved blocks");
+	checkMovable(a, 200, 0xA1);
+	checkMovable(b, 300, 0xB2);
+	checkMovable(c, 400, 0xC3);
+
+	//after unpinning the last block closes the hole, a second compaction has nothing to move
+	heap_unpin(c);
+	expectedMoved += blockSize(c->block);
+	moved += heap_compact();
+	checkHeap();
+	check(moved == expectedMoved, "unpinned block was not moved");
+	check(blockNextPhys(b->block) == c->block, "hole is not closed");
+	checkMovable(c, 400, 0xC3);
+	check(heap_compact() == 0, "compacted heap was compacted again");
+
+	heap_getDetailedStats(&stats);
+	check(stats.movedMem == initialMoved + moved, "moved memory statistic is wrong");
+
+	heap_freeMovable(a);
+	heap_freeMovable(b);
+	heap_freeMovable(c);
+	checkHeap();
+	check(handleCount == 0, "handles are not released");
+	check(freeMem == initialFree, "memory is lost");
+}
+
+static void checkOwner(uint32_t owner, size_t liveMem, size_t blockCount, size_t allocCount)
+{
+	Heap_OwnerStats stats;
+	check(heap_getOwnerStats(owner, &stats) == ERROR_NONE, "owner stats not aviable");
+	check(stats.liveMem == liveMem, "owner live memory is wrong");
+	check(stats.blockCount == blockCount, "owner block count is wrong");
+	check(stats.allocCount == allocCount, "owner allocation count is wrong");
+	check(stats.peakMem >= stats.liveMem, "owner peak is below live memory");
+}
+
+static void testOwners(void)
+{
+	size_t initialFree = freeMem;
+
+	uint32_t owner = heap_registerOwner("heaptest");
+	uint32_t other = heap_registerOwner("heaptest2");
+	check(owner != HEAP_OWNER_NONE && other != HEAP_OWNER_NONE && owner != other, "owner registration failed");
+	check(heap_registerOwner("heaptest") == owner, "registering a name again returns another owner");
+	check(heap_getOwnerCount() == 3, "owner count is wrong");
+
+	uint32_t prevOwner = heap_setCurrentOwner(owner);
+	check(prevOwner == HEAP_OWNER_NONE, "initial owner is not HEAP_OWNER_NONE");
+	uint8_t* mem = heap_alloc(100);
+	heap_setCurrentOwner(other);
+	uint8_t* blocker = heap_alloc(100);
+	check(mem != NULL && blocker != NULL, "allocation failed");
+	check(blockNextPhys(memToBlock(mem)) == memToBlock(blocker), "blocks are not neighbours");
+	checkOwner(owner, blockSize(memToBlock(mem)), 1, 1);
+	checkOwner(other, blockSize(memToBlock(blocker)), 1, 1);
+
+	//reallocation keeps the owner of the block (not the current owner), in place and moving
+	uint8_t* shrunk = heap_realloc(mem, 40);
+	check(shrunk == mem, "shrinking block moved");
+	checkOwner(owner, blockSize(memToBlock(mem)), 1, 2);
+	mem = heap_realloc(mem, 1000);
+	check(mem != NULL && mem != shrunk, "block didn't move");
+	check(blockOwner(memToBlock(mem)) == owner, "moved block lost its owner");
+	checkOwner(owner, blockSize(memToBlock(mem)), 1, 3);
+	checkOwner(other, blockSize(memToBlock(blocker)), 1, 1);
+
+	//reassigned blocks move their accounting
+	check(heap_setOwner(blocker, owner) == ERROR_NONE, "owner can't be set");
+	checkOwner(owner, blockSize(memToBlock(mem)) + blockSize(memToBlock(blocker)), 2, 4);
+	checkOwner(other, 0, 0, 0);
+	check(heap_setOwner(blocker, 200) == ERROR_INVALID_ARGUMENT, "invalid owner accepted");
+
+	heap_free(mem);
+	checkOwner(owner, blockSize(memToBlock(blocker)), 1, 4);
+	heap_free(blocker);
+	checkOwner(owner, 0, 0, 4);
+	heap_setCurrentOwner(prevOwner);
+	checkHeap();
+	check(freeMem == initialFree, "memory is lost");
+}
+
+static IsrPool* findPool(size_t size)
+{
+	for (size_t i = 0; i < HEAP_ISR_POOL_COUNT; i++)
+	{
+		if (isrPools[i].size == size)
+			return &isrPools[i];
+	}
+
+	return NULL;
+}
+
+static void checkPool(const IsrPool* pool, uint32_t count)
+{
+	check(pool->count == count, "pool block count is wrong");
+
+	uint32_t nodes = 0;
+	for (const Atomic_Node* node = pool->head; node != NULL; node = node->next)
+	{
+		const MemoryNode* block = memToBlock((void*)node);
+		check(!blockIsFree(block) && blockSize(block) >= pool->size + BLOCK_HEADER_SIZE, "pool block is free or too small");
+		check(blockOwner(block) == HEAP_OWNER_NONE, "pool block has an owner");
+		nodes++;
+	}
+	check(nodes == count, "pool stack doesn't match the pool count");
+}
+
+static void testIsrPools(void)
+{
+	//reserved in descending size order, interrupt allocations must still use the smallest suitable pool
+	check(heap_reserveIsrPool(256, 2, HEAP_ATTR_ANY) == ERROR_NONE, "pool reservation failed");
+	check(heap_reserveIsrPool(64, 2, HEAP_ATTR_ANY) == ERROR_NONE, "pool reservation failed");
+	check(heap_reserveIsrPool(64, 1, HEAP_ATTR_ANY) == ERROR_NONE, "pool reservation failed");
+	IsrPool* small = findPool(64);
+	IsrPool* large = findPool(256);
+	check(small != NULL && large != NULL && small->target == 3, "reservations with the same size don't share a pool");
+	checkPool(small, 3);
+	checkPool(large, 2);
+	checkHeap();
+	size_t reservedFree = freeMem;
+
+	//handler mode: allocations are taken from the pools, frees are deferred
+	host_ipsr = 16;
+	void* mem[5];
+	for (size_t i = 0; i < 3; i++)
+	{
+		mem[i] = heap_alloc(32);
+		check(mem[i] != NULL && small->count == 2 - i, "small allocation wasn't served by the smallest pool");
+	}
+	mem[3] = heap_alloc(32);
+	check(mem[3] != NULL && large->count == 1, "allocation didn't fall back to the next pool");
+	mem[4] = heap_alloc(200);
+	check(mem[4] != NULL && large->count == 0, "allocation wasn't served by the large pool");
+	check(heap_alloc(32) == NULL, "empty pools served an allocation");
+	check(heap_realloc(mem[0], 16) == NULL, "realloc succeeded in handler mode");
+	check(freeMem == reservedFree, "handler mode changed the heap");
+
+	for (size_t i = 0; i < 5; i++)
+	{
+		heap_free(mem[i]);
+		check(!blockIsFree(memToBlock(mem[i])), "block freed in handler mode was released at once");
+	}
+	heap_processDeferred();
+	check(deferredFrees != NULL, "deferred blocks were processed in handler mode");
+	host_ipsr = 0;
+
+	//thread mode: deferred blocks are released and the pools are refilled (without the current owner)
+	uint32_t prevOwner = heap_setCurrentOwner(heap_registerOwner("heaptest"));
+	heap_processDeferred();
+	heap_setCurrentOwner(prevOwner);
+	checkHeap();
+	check(deferredFrees == NULL, "deferred blocks are not released");
+	checkPool(small, 3);
+	checkPool(large, 2);
+	check(freeMem == reservedFree, "memory is lost");
+}
+
+int main(void)
+{
+	heap_init();
+	checkHeap();
+	check(regionCount == device_memoryMapEntryCount, "not every memory section is a region");
+	size_t initialFree = freeMem;
+
+	testCoalescing();
+	testReallocMove();
+	testCompaction();
+	testOwners();
+
+	for (operation = 1; operation <= OPERATION_COUNT; operation++)
+	{
+		randomOperation();
+		if (operation <= FULL_CHECK_OPERATIONS || (operation % 64) == 0)
+			checkHeap();
+	}
+
+	//free everything, every region must be one free block again
+	for (size_t i = 0; i < SLOT_COUNT; i++)
+	{
+		heap_free(slots[i].mem);
+		slots[i].mem = NULL;
+	}
+	checkHeap();
+	check(freeMem == initialFree, "memory is lost");
+	for (size_t i = 0; i < regionCount; i++)
+		check(regions[i]->freeBlockCount == 1, "region is not one free block again");
+
+	//pools stay reserved, so they are tested last
+	testIsrPools();
+
+	hostio_printf("heaptest: %u operations passed\n", OPERATION_COUNT);
+	return 0;
+}
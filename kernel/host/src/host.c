@@ -0,0 +1,102 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host device module.
+ *
+ * Emulates the memory map of the stm32f4discovery (SRAM and CCM) with static arrays and provides the linker script symbols.
+ * The kernel image symbols point to a separate dummy image, so the whole memory map is heap memory.
+ * Kernel critical sections of interrupt.c (which needs the real NVIC) are replaced by an emulated interrupt mask.
+ * Kernel code stores pointers in 32 bit words, so host tools must be linked below 4 GiB (no position independent executable).
+ */
+
+#include <kernel.h>
+#include <interrupt.h>
+#include <device.h>
+#include "hostio.h"
+
+#define HOST_SRAM_SIZE (128*1024)
+#define HOST_CCM_SIZE (64*1024)
+
+static uint8_t hostSram[HOST_SRAM_SIZE] __attribute__((aligned(8)));
+static uint8_t hostCcm[HOST_CCM_SIZE] __attribute__((aligned(8)));
+uint8_t host_image[64] __attribute__((aligned(8)));	//dummy kernel image (text, data, bss, stack, RAM vector table)
+
+const Device_MemorySection device_memoryMap[] =
+{
+	{ hostSram, hostSram + HOST_SRAM_SIZE - 1, HOST_SRAM_SIZE, true, DEVICE_MEMORY_ATTR_DMA },
+	{ hostCcm, hostCcm + HOST_CCM_SIZE - 1, HOST_CCM_SIZE, true, DEVICE_MEMORY_ATTR_FAST }
+};
+
+const size_t device_memoryMapEntryCount = 2;
+
+//the kernel declares the linker symbols as objects, define them as addresses in the dummy image
+__asm__(
+	".globl _textStart\n .set _textStart, host_image\n"
+	".globl _textEnd\n .set _textEnd, host_image+8\n"
+	".globl _dataStart\n .set _dataStart, host_image+8\n"
+	".globl _dataEnd\n .set _dataEnd, host_image+16\n"
+	".globl _bssStart\n .set _bssStart, host_image+16\n"
+	".globl _bssEnd\n .set _bssEnd, host_image+24\n"
+	".globl _stackEnd\n .set _stackEnd, host_image+24\n"
+	".globl _stackStart\n .set _stackStart, host_image+32\n"
+	".globl _ivectorRamStart\n .set _ivectorRamStart, host_image+32\n"
+	".globl _ivectorRamEnd\n .set _ivectorRamEnd, host_image+40\n");
+
+uint32_t host_ipsr = 0;
+DWT_Type host_dwt;
+CoreDebug_Type host_coreDebug;
+uint32_t SystemCoreClock = 168000000;
+void (*host_waitHook)(void) = NULL;
+uint32_t host_basepri = 0;
+void (*host_irqHook)(void) = NULL;
+
+//critical sections only track the emulated interrupt mask (no interrupts on the host)
+uint32_t int_enterCritical(void)
+{
+	uint32_t state = host_basepri;
+	host_basepri = INT_KERNEL_CEILING_PRIORITY;
+	return state;
+}
+
+void int_exitCritical(uint32_t state)
+{
+	host_basepri = state;
+
+	//interrupts which were pended during the critical section are taken when the mask is lowered
+	if (host_basepri == 0 && host_irqHook != NULL)
+	{
+		void (*hook)(void) = host_irqHook;
+		uint32_t ipsr = host_ipsr;
+		host_irqHook = NULL;
+		host_ipsr = 16;
+		hook();
+		host_ipsr = ipsr;
+		host_irqHook = hook;
+	}
+}
+
+void kernel_panic(const char* moduleName, error_t errorCode)
+{
+	hostio_printf("KERNEL PANIC asserted by %s module, error code %u\n", moduleName, errorCode);
+	hostio_exit(2);
+}
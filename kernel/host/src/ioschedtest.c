@@ -0,0 +1,434 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host test of the I/O scheduler.
+ *
+ * The requests are served by a RAM disk which logs every device operation (vectored operations can be shortened or failed).
+ * Directed cases check C-LOOK order, merging of adjacent requests, the merge limit, automatic dispatch of a full queue,
+ * failed and short merged transfers and the counters. A randomized workload checks after every dispatch:
+ * - every request is completed exactly once with its full size
+ * - the device operations ascend from the elevator position, wrap around once and ascend again
+ * - every operation is counted, merged requests are counted once (submitted == operations + merged)
+ */
+
+#include <iosched.h>
+#include <dev.h>
+#include <heap.h>
+#include <slab.h>
+#include <workq.h>
+#include <util.h>
+#include "hostio.h"
+
+#define BLOCK_SIZE 512
+#define DISK_BLOCKS 64
+#define LOG_SIZE 64
+#define REQUEST_COUNT 32
+#define DISPATCH_COUNT 20000
+
+typedef struct Operation
+{
+	char type;		//'r'/'w' single, 'R'/'W' vectored
+	size_t offset;
+	size_t size;
+	size_t count;	//number of buffers
+} Operation;
+
+static uint8_t disk[DISK_BLOCKS * BLOCK_SIZE];
+static Operation opLog[LOG_SIZE];
+static size_t logCount;
+static size_t vectoredLimit = SIZE_MAX;	//vectored operations transfer at most this many bytes
+static Dev_Device device;
+static uint32_t randomState = 1;
+static uint32_t operation;
+
+static uint32_t nextRandom(void)
+{
+	randomState = randomState * 1664525U + 1013904223U;
+	return randomState >> 8;
+}
+
+static void check(bool condition, const char* message)
+{
+	if (condition)
+		return;
+
+	hostio_printf("ioschedtest: FAILED after dispatch %u: %s\n", operation, message);
+	hostio_exit(1);
+}
+
+/********** RAM disk **********/
+
+static void logOperation(char type, size_t offset, size_t size, size_t count)
+{
+	check(logCount < LOG_SIZE, "too many device operations");
+	opLog[logCount++] = (Operation){ type, offset, size, count };
+}
+
+static size_t diskRead(Dev_Device* dev, void* buf, size_t size, size_t offset)
+{
+	logOperation('r', offset, size, 1);
+	if (offset > sizeof(disk) || size > sizeof(disk) - offset)
+		return 0;
+
+	util_memcpy(disk + offset, buf, size);
+	return size;
+}
+
+static size_t diskWrite(Dev_Device* dev, const void* buf, size_t size, size_t offset)
+{
+	logOperation('w', offset, size, 1);
+	if (offset > sizeof(disk) || size > sizeof(disk) - offset)
+		return 0;
+
+	util_memcpy(buf, disk + offset, size);
+	return size;
+}
+
+static size_t diskTransferv(const Dev_IoVec* vec, size_t count, size_t offset, bool write)
+{
+	size_t total = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t size = vec[i].size;
+		if (size > vectoredLimit - total)
+			size = vectoredLimit - total;
+		if (offset + total + size > sizeof(disk))
+			break;
+
+		if (write)
+			util_memcpy(vec[i].base, disk + offset + total, size);
+		else
+			util_memcpy(disk + offset + total, vec[i].base, size);
+		total += size;
+		if (size != vec[i].size)
+			break;
+	}
+
+	return total;
+}
+
+static size_t diskReadv(Dev_Device* dev, const Dev_IoVec* vec, size_t count, size_t offset)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < count; i++)
+		size += vec[i].size;
+	logOperation('R', offset, size, count);
+	return diskTransferv(vec, count, offset, false);
+}
+
+static size_t diskWritev(Dev_Device* dev, const Dev_IoVec* vec, size_t count, size_t offset)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < count; i++)
+		size += vec[i].size;
+	logOperation('W', offset, size, count);
+	return diskTransferv(vec, count, offset, true);
+}
+
+/********** requests **********/
+
+typedef struct TestRequest
+{
+	Dev_Request request;
+	uint8_t buf[2 * BLOCK_SIZE];
+	uint32_t completions;
+} TestRequest;
+
+static TestRequest requests[REQUEST_COUNT];
+
+static void completed(Dev_Request* request)
+{
+	((TestRequest*)request->context)->completions++;
+}
+
+static Dev_Request* prepare(size_t index, DEV_REQUEST_TYPE type, size_t block, size_t blocks)
+{
+	TestRequest* test = &requests[index];
+	test->request = (Dev_Request){ .type = type, .buf = test->buf, .size = blocks * BLOCK_SIZE, .offset = block * BLOCK_SIZE,
+			.callback = completed, .context = test };
+	test->completions = 0;
+
+	//writes carry their block number, so the disk content shows which request wrote a block
+	for (size_t i = 0; i < blocks * BLOCK_SIZE; i++)
+		test->buf[i] = (uint8_t)(block + i / BLOCK_SIZE + index * 64);
+	return &test->request;
+}
+
+static void checkDone(size_t index, size_t transferred, error_t error)
+{
+	const TestRequest* test = &requests[index];
+	check(test->completions == 1, "request is not completed exactly once");
+	check(test->request.status == DEV_REQUEST_STATUS_DONE, "request status is not done");
+	check(test->request.transferred == transferred, "transferred bytes of the request are wrong");
+	check(test->request.error == error, "error of the request is wrong");
+}
+
+static void checkOperation(size_t index, char type, size_t block, size_t blocks, size_t count)
+{
+	check(index < logCount, "device operation is missing");
+	const Operation* op = &opLog[index];
+	check(op->type == type && op->offset == block * BLOCK_SIZE && op->size == blocks * BLOCK_SIZE && op->count == count, "device operation is wrong");
+}
+
+static bool sameContent(const uint8_t* buf, size_t block, size_t blocks)
+{
+	for (size_t i = 0; i < blocks * BLOCK_SIZE; i++)
+	{
+		if (buf[i] != disk[block * BLOCK_SIZE + i])
+			return false;
+	}
+
+	return true;
+}
+
+static void checkCounters(const Iosched_Queue* queue, uint32_t submitted, uint32_t operations, uint32_t merged)
+{
+	check(queue->submitted == submitted, "submitted counter is wrong");
+	check(queue->operations == operations, "operations counter is wrong");
+	check(queue->merged == merged, "merged counter is wrong");
+	check(queue->depth == 0 && queue->requests == NULL, "queue is not empty after dispatch");
+}
+
+/********** directed tests **********/
+
+static void testOrder(void)
+{
+	Iosched_Queue queue;
+	iosched_initQueue(&queue, &device, IOSCHED_POLICY_ELEVATOR);
+
+	//move the elevator position to block 5
+	iosched_submit(&queue, prepare(0, DEV_REQUEST_TYPE_READ, 4, 1));
+	iosched_dispatch(&queue);
+	check(queue.position == 5 * BLOCK_SIZE, "elevator position is wrong");
+
+	//requests behind the position first (ascending), then wrap around (gaps prevent merging)
+	logCount = 0;
+	iosched_submit(&queue, prepare(1, DEV_REQUEST_TYPE_READ, 0, 1));
+	iosched_submit(&queue, prepare(2, DEV_REQUEST_TYPE_WRITE, 10, 1));
+	iosched_submit(&queue, prepare(3, DEV_REQUEST_TYPE_READ, 2, 1));
+	iosched_submit(&queue, prepare(4, DEV_REQUEST_TYPE_READ, 6, 1));
+	check(logCount == 0 && queue.depth == 4, "requests were not queued");
+	iosched_dispatch(&queue);
+
+	check(logCount == 4, "wrong number of device operations");
+	checkOperation(0, 'r', 6, 1, 1);
+	checkOperation(1, 'w', 10, 1, 1);
+	checkOperation(2, 'r', 0, 1, 1);
+	checkOperation(3, 'r', 2, 1, 1);
+	for (size_t i = 0; i <= 4; i++)
+		checkDone(i, BLOCK_SIZE, ERROR_NONE);
+	checkCounters(&queue, 5, 5, 0);
+	check(queue.maxDepth == 4, "maximum depth is wrong");
+}
+
+static void testMerge(void)
+{
+	Iosched_Queue queue;
+	iosched_initQueue(&queue, &device, IOSCHED_POLICY_ELEVATOR);
+	logCount = 0;
+
+	//adjacent writes in any submission order become one operation, a read between writes splits the runs
+	iosched_submit(&queue, prepare(0, DEV_REQUEST_TYPE_WRITE, 2, 1));
+	iosched_submit(&queue, prepare(1, DEV_REQUEST_TYPE_WRITE, 0, 2));
+	iosched_submit(&queue, prepare(2, DEV_REQUEST_TYPE_WRITE, 3, 1));
+	iosched_submit(&queue, prepare(3, DEV_REQUEST_TYPE_READ, 4, 1));
+	iosched_submit(&queue, prepare(4, DEV_REQUEST_TYPE_WRITE, 5, 1));
+	//same offset as an earlier write: queued behind it, so it wins
+	iosched_submit(&queue, prepare(5, DEV_REQUEST_TYPE_WRITE, 5, 1));
+	iosched_dispatch(&queue);
+
+	check(logCount == 4, "wrong number of device operations");
+	checkOperation(0, 'W', 0, 4, 3);
+	checkOperation(1, 'r', 4, 1, 1);
+	checkOperation(2, 'w', 5, 1, 1);
+	checkOperation(3, 'w', 5, 1, 1);
+	for (size_t i = 0; i < 6; i++)
+		checkDone(i, requests[i].request.size, ERROR_NONE);
+	checkCounters(&queue, 6, 4, 2);
+
+	//content arrived in the right blocks
+	check(disk[0] == requests[1].buf[0] && disk[BLOCK_SIZE] == requests[1].buf[BLOCK_SIZE], "merged write wrote the wrong blocks");
+	check(disk[2 * BLOCK_SIZE] == requests[0].buf[0] && disk[3 * BLOCK_SIZE] == requests[2].buf[0], "merged write wrote the wrong blocks");
+	check(sameContent(requests[3].buf, 4, 1), "read between writes returned wrong data");
+	check(disk[5 * BLOCK_SIZE] == requests[5].buf[0], "requests with the same offset were reordered");
+
+	//more adjacent requests than IOSCHED_MERGE_MAX are split into several operations
+	logCount = 0;
+	for (size_t i = 0; i < IOSCHED_MERGE_MAX + 2; i++)
+		iosched_submit(&queue, prepare(i, DEV_REQUEST_TYPE_READ, 20 + i, 1));
+	iosched_dispatch(&queue);
+	check(logCount == 2, "merge limit is not kept");
+	checkOperation(0, 'R', 20, IOSCHED_MERGE_MAX, IOSCHED_MERGE_MAX);
+	checkOperation(1, 'R', 20 + IOSCHED_MERGE_MAX, 2, 2);
+	for (size_t i = 0; i < IOSCHED_MERGE_MAX + 2; i++)
+	{
+		checkDone(i, BLOCK_SIZE, ERROR_NONE);
+		check(sameContent(requests[i].buf, 20 + i, 1), "merged read returned wrong data");
+	}
+	checkCounters(&queue, 6 + IOSCHED_MERGE_MAX + 2, 6, 2 + IOSCHED_MERGE_MAX);
+}
+
+static void testFull(void)
+{
+	Iosched_Queue queue;
+	iosched_initQueue(&queue, &device, IOSCHED_POLICY_ELEVATOR);
+	logCount = 0;
+
+	//the request which fills the queue dispatches it
+	for (size_t i = 0; i < IOSCHED_QUEUE_DEPTH_MAX - 1; i++)
+		iosched_submit(&queue, prepare(i, DEV_REQUEST_TYPE_WRITE, 2 * i, 1));
+	check(logCount == 0 && queue.depth == IOSCHED_QUEUE_DEPTH_MAX - 1, "queue was dispatched before it was full");
+	iosched_submit(&queue, prepare(IOSCHED_QUEUE_DEPTH_MAX - 1, DEV_REQUEST_TYPE_WRITE, 2 * (IOSCHED_QUEUE_DEPTH_MAX - 1), 1));
+	check(logCount == IOSCHED_QUEUE_DEPTH_MAX && queue.maxDepth == IOSCHED_QUEUE_DEPTH_MAX, "full queue was not dispatched");
+	checkCounters(&queue, IOSCHED_QUEUE_DEPTH_MAX, IOSCHED_QUEUE_DEPTH_MAX, 0);
+
+	//requests without buffer are rejected and not counted
+	Dev_Request* request = prepare(0, DEV_REQUEST_TYPE_READ, 0, 1);
+	request->buf = NULL;
+	check(iosched_submit(&queue, request) == ERROR_INVALID_ADDRESS && queue.submitted == IOSCHED_QUEUE_DEPTH_MAX, "request without buffer accepted");
+}
+
+static void testFailures(void)
+{
+	Iosched_Queue queue;
+	iosched_initQueue(&queue, &device, IOSCHED_POLICY_ELEVATOR);
+
+	//a merged operation which transfers nothing fails all of its requests (no retry)
+	logCount = 0;
+	vectoredLimit = 0;
+	for (size_t i = 0; i < 3; i++)
+		iosched_submit(&queue, prepare(i, DEV_REQUEST_TYPE_READ, i, 1));
+	iosched_dispatch(&queue);
+	check(logCount == 1, "failed merged operation was retried");
+	for (size_t i = 0; i < 3; i++)
+		checkDone(i, 0, ERROR_DEV_IO_FAILED);
+	checkCounters(&queue, 3, 1, 2);
+
+	//a short transfer fails the request it ends in, the following requests are executed on their own
+	logCount = 0;
+	vectoredLimit = BLOCK_SIZE + BLOCK_SIZE / 2;
+	for (size_t i = 0; i < 4; i++)
+		iosched_submit(&queue, prepare(i, DEV_REQUEST_TYPE_WRITE, 8 + i, 1));
+	iosched_dispatch(&queue);
+	vectoredLimit = SIZE_MAX;
+	check(logCount == 3, "wrong number of device operations");
+	checkOperation(0, 'W', 8, 4, 4);
+	checkOperation(1, 'w', 10, 1, 1);
+	checkOperation(2, 'w', 11, 1, 1);
+	checkDone(0, BLOCK_SIZE, ERROR_NONE);
+	checkDone(1, BLOCK_SIZE / 2, ERROR_OUT_OF_RANGE);
+	checkDone(2, BLOCK_SIZE, ERROR_NONE);
+	checkDone(3, BLOCK_SIZE, ERROR_NONE);
+	checkCounters(&queue, 7, 4, 5);
+
+	//single requests the device can't execute fail and aren't counted as operations
+	Dev_Device readOnly = device;
+	readOnly.name = "readonly";
+	readOnly.write = NULL;
+	readOnly.writev = NULL;
+	check(dev_registerDevice(&readOnly) == ERROR_NONE, "registration failed");
+	iosched_initQueue(&queue, &readOnly, IOSCHED_POLICY_ELEVATOR);
+	iosched_submit(&queue, prepare(0, DEV_REQUEST_TYPE_WRITE, 0, 1));
+	iosched_dispatch(&queue);
+	checkDone(0, 0, ERROR_DEV_OPERATION_NOT_SUPPORTED);
+	checkCounters(&queue, 1, 0, 0);
+
+	//without queueing, only accepted requests are operations
+	iosched_initQueue(&queue, &readOnly, IOSCHED_POLICY_NOOP);
+	check(iosched_submit(&queue, prepare(0, DEV_REQUEST_TYPE_WRITE, 0, 1)) == ERROR_DEV_OPERATION_NOT_SUPPORTED, "unsupported request accepted");
+	check(iosched_submit(&queue, prepare(1, DEV_REQUEST_TYPE_READ, 0, 1)) == ERROR_NONE, "request failed");
+	checkDone(1, BLOCK_SIZE, ERROR_NONE);
+	checkCounters(&queue, 2, 1, 0);
+	dev_unregisterDevice(&readOnly);
+}
+
+/********** randomized workload **********/
+
+static void randomDispatch(Iosched_Queue* queue)
+{
+	size_t startPosition = queue->position;
+	uint32_t submitted = queue->submitted;
+	uint32_t operations = queue->operations;
+	uint32_t merged = queue->merged;
+	logCount = 0;
+
+	//less than a full queue, so the dispatch happens here
+	size_t count = 1 + nextRandom() % (IOSCHED_QUEUE_DEPTH_MAX - 1);
+	for (size_t i = 0; i < count; i++)
+	{
+		DEV_REQUEST_TYPE type = (nextRandom() & 1) ? DEV_REQUEST_TYPE_READ : DEV_REQUEST_TYPE_WRITE;
+		size_t blocks = 1 + nextRandom() % 2;
+		check(iosched_submit(queue, prepare(i, type, nextRandom() % (DISK_BLOCKS - 1), blocks)) == ERROR_NONE, "submit failed");
+	}
+	check(logCount == 0, "requests were dispatched before iosched_dispatch");
+	iosched_dispatch(queue);
+
+	for (size_t i = 0; i < count; i++)
+		checkDone(i, requests[i].request.size, ERROR_NONE);
+	check(queue->submitted - submitted == count, "submitted counter is wrong");
+	check(queue->operations - operations == logCount, "operations counter doesn't match the device operations");
+	check((queue->operations - operations) + (queue->merged - merged) == count, "merged requests are not counted once");
+	check(queue->depth == 0, "queue is not empty after dispatch");
+
+	//C-LOOK: ascending from the start position, at most one wrap to a lower offset, ascending again below the start position
+	bool wrapped = false;
+	for (size_t i = 0; i < logCount; i++)
+	{
+		if (!wrapped)
+		{
+			if (opLog[i].offset < startPosition)
+				wrapped = true;
+			else
+				check(i == 0 || opLog[i].offset >= opLog[i - 1].offset, "operations behind the position are not ascending");
+		}
+		else
+		{
+			check(opLog[i].offset >= opLog[i - 1].offset && opLog[i].offset < startPosition, "operations after the wrap are not ascending");
+		}
+	}
+}
+
+int main(void)
+{
+	heap_init();
+	workq_init();
+	dev_init();
+
+	device = (Dev_Device){ .name = "disk", .number = 0, .type = DEV_DEVICE_TYPE_BLOCK, .read = diskRead, .write = diskWrite,
+			.readv = diskReadv, .writev = diskWritev };
+	check(dev_registerDevice(&device) == ERROR_NONE, "registration failed");
+
+	testOrder();
+	testMerge();
+	testFull();
+	testFailures();
+
+	Iosched_Queue queue;
+	iosched_initQueue(&queue, &device, IOSCHED_POLICY_ELEVATOR);
+	for (operation = 1; operation <= DISPATCH_COUNT; operation++)
+		randomDispatch(&queue);
+
+	dev_unregisterDevice(&device);
+	hostio_printf("ioschedtest: %u dispatches passed\n", DISPATCH_COUNT);
+	return 0;
+}
@@ -0,0 +1,71 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host latency statistics module. */
+
+#include "latency.h"
+#include "hostio.h"
+
+void latency_init(Latency* latency)
+{
+	latency->count = 0;
+	latency->totalNs = 0;
+	latency->maxNs = 0;
+	for (uint32_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+		latency->buckets[i] = 0;
+}
+
+void latency_add(Latency* latency, uint64_t ns)
+{
+	uint64_t bucket = ns / LATENCY_BUCKET_NS;
+	if (bucket >= LATENCY_BUCKET_COUNT)
+		bucket = LATENCY_BUCKET_COUNT - 1;
+
+	latency->buckets[bucket]++;
+	latency->count++;
+	latency->totalNs += ns;
+	if (ns > latency->maxNs)
+		latency->maxNs = ns;
+}
+
+uint64_t latency_percentile(const Latency* latency, uint32_t percent)
+{
+	uint64_t limit = (latency->count * percent + 99) / 100;
+	uint64_t count = 0;
+	for (uint32_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+	{
+		count += latency->buckets[i];
+		if (count >= limit && count > 0)
+			return (uint64_t)(i + 1) * LATENCY_BUCKET_NS;
+	}
+
+	return latency->maxNs;
+}
+
+void latency_print(const char* name, const Latency* latency)
+{
+	uint64_t average = (latency->count > 0) ? latency->totalNs / latency->count : 0;
+	hostio_printf("  %-12s count %8llu  avg %6llu ns  p50 <= %6llu ns  p99 <= %6llu ns  max %8llu ns\n", name,
+			(unsigned long long)latency->count, (unsigned long long)average, (unsigned long long)latency_percentile(latency, 50),
+			(unsigned long long)latency_percentile(latency, 99), (unsigned long long)latency->maxNs);
+}
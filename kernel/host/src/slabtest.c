@@ -0,0 +1,236 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host test of the slab allocator.
+ *
+ * Caches of small, medium and oversized objects are checked against their statistics after every operation:
+ * - object sizes are aligned to 4 and can hold the free list pointer, oversized objects get a chunk of their own
+ * - objects are aligned, lie inside a chunk of their cache and don't overlap (every object is filled with a pattern which is verified)
+ * - a chunk is only allocated if the free list is empty, freed objects are reused before
+ * - deinitialization returns all chunks to heap
+ */
+
+#include <slab.h>
+#include <heap.h>
+#include "hostio.h"
+
+#define CACHE_COUNT 3
+#define SLOT_COUNT 128
+#define OPERATION_COUNT 100000
+#define FULL_CHECK_OPERATIONS 10000	//check after every operation until then, afterwards after every 64th operation
+
+typedef struct Slot
+{
+	uint8_t* object;	//allocated object (NULL if slot is unused)
+	uint8_t pattern;	//fill byte
+} Slot;
+
+typedef struct TestCache
+{
+	Slab_Cache cache;
+	size_t requestedSize;
+	Slot slots[SLOT_COUNT];
+} TestCache;
+
+static TestCache caches[CACHE_COUNT];
+static uint32_t randomState = 1;
+static uint32_t operation;
+
+static uint32_t nextRandom(void)
+{
+	randomState = randomState * 1664525U + 1013904223U;
+	return randomState >> 8;
+}
+
+static void check(bool condition, const char* message)
+{
+	if (condition)
+		return;
+
+	hostio_printf("slabtest: FAILED after operation %u: %s\n", operation, message);
+	hostio_exit(1);
+}
+
+static size_t heapFree(void)
+{
+	size_t heapSize, allocMem, freeMem;
+	heap_getStats(&heapSize, &allocMem, &freeMem);
+	return freeMem;
+}
+
+/********** invariants **********/
+
+//objects follow the chunk link of their chunk
+static bool isInChunk(const Slab_Cache* cache, const uint8_t* object)
+{
+	for (void* const* chunk = cache->slabs; chunk != NULL; chunk = *chunk)
+	{
+		const uint8_t* objects = (const uint8_t*)(chunk + 1);
+		if (object >= objects && object < objects + cache->objectsPerSlab * cache->objectSize)
+			return (size_t)(object - objects) % cache->objectSize == 0;
+	}
+
+	return false;
+}
+
+static void checkCache(const TestCache* test)
+{
+	const Slab_Cache* cache = &test->cache;
+	Slab_Stats stats;
+	slab_getStats(cache, &stats);
+
+	size_t inUse = 0;
+	for (size_t i = 0; i < SLOT_COUNT; i++)
+	{
+		const Slot* slot = &test->slots[i];
+		if (slot->object == NULL)
+			continue;
+
+		check(((uintptr_t)slot->object & 3) == 0, "object is not aligned");
+		check(isInChunk(cache, slot->object), "object is not in a chunk of its cache");
+		for (size_t j = 0; j < test->requestedSize; j++)
+			check(slot->object[j] == slot->pattern, "object was overwritten (overlapping objects)");
+		inUse++;
+	}
+
+	size_t freeCount = 0;
+	for (void* const* object = cache->freeObjects; object != NULL; object = *object)
+	{
+		check(isInChunk(cache, (const uint8_t*)object), "free object is not in a chunk of its cache");
+		check(++freeCount <= stats.slabCount * cache->objectsPerSlab, "free list is longer than the chunks");
+	}
+
+	check(stats.objectsInUse == inUse, "objects in use statistic is wrong");
+	check(stats.objectsFree == freeCount, "free objects statistic is wrong");
+	check(stats.objectsInUse + stats.objectsFree == stats.slabCount * cache->objectsPerSlab, "objects don't fill the chunks");
+	check(stats.wasteSize == stats.slabCount * (stats.slabSize - cache->objectsPerSlab * cache->objectSize), "waste statistic is wrong");
+}
+
+/********** tests **********/
+
+static void testInit(void)
+{
+	Slab_Cache cache;
+
+	//tiny objects hold at least the free list pointer
+	slab_initCache(&cache, "tiny", 1);
+	check(cache.objectSize >= sizeof(void*) && (cache.objectSize & 3) == 0, "tiny object size is wrong");
+
+	slab_initCache(&cache, "odd", 13);
+	check(cache.objectSize == 16, "object size is not aligned to 4");
+	check(cache.objectsPerSlab == (SLAB_CHUNK_SIZE - sizeof(void*)) / 16, "objects per chunk is wrong");
+
+	//no memory until the first object is requested
+	check(cache.slabs == NULL && cache.slabCount == 0, "initialization allocated a chunk");
+
+	slab_initCache(&cache, "large", SLAB_CHUNK_SIZE);
+	check(cache.objectsPerSlab == 1, "oversized object doesn't get its own chunk");
+}
+
+static void testReuse(void)
+{
+	size_t initialFree = heapFree();
+	Slab_Cache cache;
+	slab_initCache(&cache, "reuse", 32);
+
+	//objects of a new chunk are handed out by ascending address
+	uint8_t* first = slab_alloc(&cache);
+	uint8_t* second = slab_alloc(&cache);
+	check(first != NULL && second == first + cache.objectSize, "objects are not handed out by ascending address");
+	check(cache.slabCount == 1, "second object allocated a chunk");
+
+	//freed objects are reused first (last in, first out)
+	slab_free(&cache, first);
+	check(slab_alloc(&cache) == first, "freed object is not reused");
+	slab_free(&cache, NULL);
+	check(cache.objectsInUse == 2, "freeing NULL changed the cache");
+
+	//a new chunk only when the chunk is used up
+	for (size_t i = 2; i < cache.objectsPerSlab; i++)
+		check(slab_alloc(&cache) != NULL, "allocation failed");
+	check(cache.slabCount == 1 && cache.freeObjects == NULL, "chunk is not used up");
+	check(slab_alloc(&cache) != NULL && cache.slabCount == 2, "no chunk allocated for a full cache");
+
+	slab_deinitCache(&cache);
+	check(cache.slabs == NULL && cache.objectsInUse == 0, "deinitialization didn't reset the cache");
+	check(heapFree() == initialFree, "chunks are not returned to heap");
+}
+
+static void randomOperation(void)
+{
+	TestCache* test = &caches[nextRandom() % CACHE_COUNT];
+	Slot* slot = &test->slots[nextRandom() % SLOT_COUNT];
+
+	if (slot->object == NULL)
+	{
+		Slab_Stats before;
+		slab_getStats(&test->cache, &before);
+
+		slot->object = slab_alloc(&test->cache);
+		check(slot->object != NULL, "allocation failed");
+		check(test->cache.slabCount == before.slabCount + (before.objectsFree == 0 ? 1 : 0), "chunk allocated although free objects were left");
+
+		slot->pattern = (uint8_t)nextRandom();
+		for (size_t i = 0; i < test->requestedSize; i++)
+			slot->object[i] = slot->pattern;
+	}
+	else
+	{
+		slab_free(&test->cache, slot->object);
+		slot->object = NULL;
+	}
+}
+
+int main(void)
+{
+	heap_init();
+	size_t initialFree = heapFree();
+
+	testInit();
+	testReuse();
+
+	static const size_t sizes[CACHE_COUNT] = { 6, 100, SLAB_CHUNK_SIZE + 100 };
+	static const char* names[CACHE_COUNT] = { "small", "medium", "oversized" };
+	for (size_t i = 0; i < CACHE_COUNT; i++)
+	{
+		caches[i].requestedSize = sizes[i];
+		slab_initCache(&caches[i].cache, names[i], sizes[i]);
+	}
+
+	for (operation = 1; operation <= OPERATION_COUNT; operation++)
+	{
+		randomOperation();
+		if (operation <= FULL_CHECK_OPERATIONS || (operation % 64) == 0)
+		{
+			for (size_t i = 0; i < CACHE_COUNT; i++)
+				checkCache(&caches[i]);
+		}
+	}
+
+	for (size_t i = 0; i < CACHE_COUNT; i++)
+		slab_deinitCache(&caches[i].cache);
+	check(heapFree() == initialFree, "memory is lost");
+
+	hostio_printf("slabtest: %u operations passed\n", OPERATION_COUNT);
+	return 0;
+}
@@ -0,0 +1,131 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host benchmark of heap_realloc on a growing-vector workload.
+ *
+ * Vectors grow in steps of VECTOR_STEP bytes up to VECTOR_SIZE bytes, either with heap_realloc or with alloc-copy-free.
+ * Several vectors grow in turn, so a vector can only grow in place until its neighbour is in the way.
+ * The benchmark reports the copied bytes, the number of moved blocks, the grow latency and the heap high-water mark.
+ */
+
+#include <heap.h>
+#include <util.h>
+#include "hostio.h"
+#include "latency.h"
+
+#define VECTOR_COUNT_MAX 4
+#define VECTOR_STEP 64
+#define VECTOR_SIZE (16*1024)
+#define REPEAT_COUNT 20
+
+typedef struct Result
+{
+	uint64_t copiedBytes;	//bytes copied by all grow operations
+	uint32_t moveCount;		//number of grow operations which moved the vector
+	size_t peakMem;			//highest allocated memory during the run (without heap control structures)
+	bool failed;			//set if an allocation failed
+} Result;
+
+static Latency growLatency;
+
+/* Grow with heap_realloc, the content is only copied if the block has to move */
+static void* growRealloc(void* mem, size_t oldSize, size_t newSize, Result* result)
+{
+	void* newMem = heap_realloc(mem, newSize);
+	if (newMem != NULL && mem != NULL && newMem != mem)
+	{
+		result->copiedBytes += oldSize;
+		result->moveCount++;
+	}
+
+	return newMem;
+}
+
+/* Grow without heap_realloc, every step allocates a new block and copies the content */
+static void* growCopy(void* mem, size_t oldSize, size_t newSize, Result* result)
+{
+	void* newMem = heap_alloc(newSize);
+	if (newMem != NULL && mem != NULL)
+	{
+		util_memcpy(mem, newMem, oldSize);
+		heap_free(mem);
+		result->copiedBytes += oldSize;
+		result->moveCount++;
+	}
+
+	return newMem;
+}
+
+static void run(const char* name, void* (*grow)(void*, size_t, size_t, Result*), size_t vectorCount)
+{
+	Result result = { 0, 0, 0, false };
+	latency_init(&growLatency);
+
+	for (uint32_t repeat = 0; repeat < REPEAT_COUNT && !result.failed; repeat++)
+	{
+		heap_init();
+		Heap_Stats stats;
+		heap_getDetailedStats(&stats);
+		size_t baseMem = stats.allocMem;
+
+		void* vectors[VECTOR_COUNT_MAX] = { NULL };
+		for (size_t size = VECTOR_STEP; size <= VECTOR_SIZE && !result.failed; size += VECTOR_STEP)
+		{
+			for (size_t i = 0; i < vectorCount; i++)
+			{
+				uint64_t start = hostio_nanoseconds();
+				void* mem = grow(vectors[i], size - VECTOR_STEP, size, &result);
+				latency_add(&growLatency, hostio_nanoseconds() - start);
+				if (mem == NULL)
+				{
+					result.failed = true;
+					break;
+				}
+				vectors[i] = mem;
+			}
+		}
+
+		heap_getDetailedStats(&stats);
+		if (stats.peakAllocMem - baseMem > result.peakMem)
+			result.peakMem = stats.peakAllocMem - baseMem;
+
+		for (size_t i = 0; i < vectorCount; i++)
+			heap_free(vectors[i]);
+	}
+
+	hostio_printf(" %s%s: %llu bytes copied, %u moves, peak %u bytes\n", name, result.failed ? " (allocation failed)" : "",
+			(unsigned long long)(result.copiedBytes / REPEAT_COUNT), result.moveCount / REPEAT_COUNT, (uint32_t)result.peakMem);
+	latency_print("grow", &growLatency);
+}
+
+int main(void)
+{
+	for (size_t vectorCount = 1; vectorCount <= VECTOR_COUNT_MAX; vectorCount *= 2)
+	{
+		hostio_printf("%u vectors growing to %u bytes in steps of %u bytes\n", (uint32_t)vectorCount, VECTOR_SIZE, VECTOR_STEP);
+		run("heap_realloc", growRealloc, vectorCount);
+		run("alloc-copy-free", growCopy, vectorCount);
+	}
+
+	return 0;
+}
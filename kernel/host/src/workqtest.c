@@ -0,0 +1,187 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Host test of the work queue.
+ *
+ * Items carry sequence numbers which are checked against a model queue:
+ * - items are executed in posting order, every posted item exactly once
+ * - items posted by executed items or by interrupts (emulated at the end of the kernel critical sections, see host_irqHook)
+ *   are executed by the same workq_run call
+ * - items are executed with interrupts enabled (no open critical section)
+ */
+
+#include <workq.h>
+#include <device.h>
+#include "hostio.h"
+
+#define ITEM_COUNT 64
+#define OPERATION_COUNT 100000
+
+typedef struct TestItem
+{
+	Workq_Item item;	//must be first member (work item is casted to test item)
+	uint32_t sequence;	//posting order
+	bool queued;
+	uint32_t reposts;	//number of times the item posts itself again
+} TestItem;
+
+static TestItem items[ITEM_COUNT];
+static uint32_t postedCount;	//sequence number of the next posted item
+static uint32_t executedCount;	//sequence number of the next expected item
+static uint32_t randomState = 1;
+static uint32_t operation;
+
+static uint32_t nextRandom(void)
+{
+	randomState = randomState * 1664525U + 1013904223U;
+	return randomState >> 8;
+}
+
+static void check(bool condition, const char* message)
+{
+	if (condition)
+		return;
+
+	hostio_printf("workqtest: FAILED after operation %u: %s\n", operation, message);
+	hostio_exit(1);
+}
+
+static void execute(Workq_Item* item);
+
+static void post(TestItem* test)
+{
+	test->item.func = execute;
+	test->sequence = postedCount++;
+	test->queued = true;
+	workq_post(&test->item);
+}
+
+/* Post a random unqueued item, returns false if all items are queued */
+static bool postRandom(void)
+{
+	size_t start = nextRandom() % ITEM_COUNT;
+	for (size_t i = 0; i < ITEM_COUNT; i++)
+	{
+		TestItem* test = &items[(start + i) % ITEM_COUNT];
+		if (!test->queued)
+		{
+			test->reposts = (nextRandom() % 8 == 0) ? 1 + nextRandom() % 3 : 0;
+			post(test);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void execute(Workq_Item* item)
+{
+	TestItem* test = (TestItem*)item;
+	check(host_ipsr == 0 && host_basepri == 0, "item is not executed in thread mode with interrupts enabled");
+	check(test->queued, "item executed twice");
+	check(test->sequence == executedCount, "items are not executed in posting order");
+	test->queued = false;
+	executedCount++;
+
+	//the item may be posted again by its function, it goes to the end of the queue
+	if (test->reposts > 0)
+	{
+		test->reposts--;
+		post(test);
+	}
+	else if (nextRandom() % 8 == 0)
+	{
+		postRandom();
+	}
+}
+
+static uint32_t interruptPosts;
+
+static void interrupt(void)
+{
+	check(host_ipsr != 0 && host_basepri == 0, "interrupt taken inside a critical section");
+	if (interruptPosts > 0 && postRandom())
+		interruptPosts--;
+}
+
+/********** tests **********/
+
+static void testOrder(void)
+{
+	check(!workq_run(), "empty queue executed an item");
+
+	for (size_t i = 0; i < 8; i++)
+	{
+		items[i].reposts = 0;
+		post(&items[i]);
+	}
+	items[2].reposts = 2;
+	check(workq_run(), "no item executed");
+	check(executedCount == postedCount && executedCount == 10, "not every item executed");
+	check(!workq_run(), "items executed after the queue was drained");
+}
+
+static void testInterrupts(void)
+{
+	//interrupts post items while items are posted and taken, the run executes all of them
+	host_irqHook = interrupt;
+	interruptPosts = 20;
+	post(&items[0]);
+	check(workq_run(), "no item executed");
+	host_irqHook = NULL;
+	check(interruptPosts == 0, "emulated interrupts didn't post");
+	check(executedCount == postedCount, "items posted by interrupts were not executed");
+}
+
+int main(void)
+{
+	workq_init();
+	testOrder();
+	testInterrupts();
+
+	//random posts from thread mode and interrupts, random runs
+	host_irqHook = interrupt;
+	for (operation = 1; operation <= OPERATION_COUNT; operation++)
+	{
+		uint32_t type = nextRandom() % 4;
+		if (type == 0)
+		{
+			workq_run();
+			check(executedCount == postedCount, "run didn't execute all queued items");
+			for (size_t i = 0; i < ITEM_COUNT; i++)
+				check(!items[i].queued, "item left in the queue");
+		}
+		else
+		{
+			interruptPosts = (type == 1) ? 1 : 0;
+			postRandom();
+		}
+	}
+
+	host_irqHook = NULL;
+	workq_run();
+	check(executedCount == postedCount, "items are lost");
+
+	hostio_printf("workqtest: %u operations passed\n", OPERATION_COUNT);
+	return 0;
+}
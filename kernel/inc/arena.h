@@ -0,0 +1,125 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file arena.h
+ *
+ * @brief Arena module. Provides bump-pointer allocation for short-lived data which is released all at once
+ * (boot structures, scratch buffers of a request). Memory is taken from heap in chunks.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <kernel.h>
+
+/**
+ * @brief Default size of a chunk which is allocated from heap (see arena_init).
+ */
+#define ARENA_CHUNK_SIZE 1024
+
+/**
+ * @brief Arena. The structure is managed by the arena module, callers only provide its memory.
+ */
+typedef struct Arena
+{
+	const char* name;		/**< Name of the arena (for debug output) **/
+	size_t chunkSize;		/**< Size of a chunk which is allocated from heap **/
+	uint32_t attributes;	/**< Memory attributes of the chunks (see HEAP_ATTR) **/
+	void* chunks;			/**< Linked list of chunks, the newest chunk first **/
+	uint8_t* pos;			/**< Next free byte in the current chunk **/
+	uint8_t* end;			/**< End of the current chunk **/
+	size_t allocMem;		/**< Number of allocated bytes **/
+	size_t chunkCount;		/**< Number of chunks **/
+} Arena;
+
+/**
+ * @brief Position in an arena, which the arena can be reset to (see arena_getMarker and arena_reset).
+ */
+typedef struct Arena_Marker
+{
+	void* chunk;		/**< Newest chunk when the marker was taken **/
+	uint8_t* pos;		/**< Next free byte when the marker was taken **/
+	uint8_t* end;		/**< End of the current chunk when the marker was taken **/
+	size_t allocMem;	/**< Number of allocated bytes when the marker was taken **/
+} Arena_Marker;
+
+/**
+ * @brief Statistics of an arena.
+ */
+typedef struct Arena_Stats
+{
+	size_t allocMem;	/**< Number of allocated bytes (aligned) **/
+	size_t chunkCount;	/**< Number of chunks **/
+	size_t chunkMem;	/**< Number of bytes in all chunks (without chunk headers) **/
+} Arena_Stats;
+
+/**
+ * @brief Initialize an arena. No memory is allocated until the first allocation.
+ * @param arena Pointer to the arena structure. Must be not NULL.
+ * @param name Name of the arena.
+ * @param chunkSize Size of the chunks which are allocated from heap, 0 for ARENA_CHUNK_SIZE.
+ * Allocations which don't fit in a chunk get a chunk of their own.
+ * @param attributes Memory attributes of the chunks (see HEAP_ATTR).
+ */
+void arena_init(Arena* arena, const char* name, size_t chunkSize, uint32_t attributes);
+
+/**
+ * @brief Allocate memory from arena. The memory can't be freed on its own, see arena_reset and arena_release.
+ * @param arena Pointer to an initialized arena. Must be not NULL.
+ * @param size The size of the needed memory. Will be aligned to 4.
+ * @return A valid address to the memory block (aligned with 4).
+ * Otherwise NULL if size is 0 or a new chunk is required and heap allocation failed.
+ */
+void* arena_alloc(Arena* arena, size_t size);
+
+/**
+ * @brief Returns the current position of an arena.
+ * @param arena Pointer to an initialized arena. Must be not NULL.
+ * @param outMarker Returns the position. Must be not NULL.
+ */
+void arena_getMarker(const Arena* arena, Arena_Marker* outMarker);
+
+/**
+ * @brief Release all memory which was allocated after the marker was taken.
+ * Chunks which were allocated after the marker are returned to heap.
+ * @param arena Pointer to an initialized arena. Must be not NULL.
+ * @param marker Position to reset to. Must be taken from the same arena and not be invalidated by an earlier reset
+ * to an older marker or arena_release.
+ */
+void arena_reset(Arena* arena, const Arena_Marker* marker);
+
+/**
+ * @brief Release all memory of an arena and return all chunks to heap. The arena can be used again afterwards.
+ * @param arena Pointer to an initialized arena. Must be not NULL.
+ */
+void arena_release(Arena* arena);
+
+/**
+ * @brief Returns stats of an arena.
+ * @param arena Pointer to an initialized arena. Must be not NULL.
+ * @param outStats Returns the stats. Must be not NULL.
+ */
+void arena_getStats(const Arena* arena, Arena_Stats* outStats);
+
+#endif // ARENA_H
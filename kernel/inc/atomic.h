@@ -0,0 +1,71 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file atomic.h
+ *
+ * @brief Atomic module. Lock-free stacks and counters (LDREX/STREX), usable from thread mode and interrupt handlers of any priority.
+ */
+
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <kernel.h>
+
+/**
+ * @brief Link of a lock-free stack, embed it in the structure which is stacked.
+ */
+typedef struct Atomic_Node
+{
+	struct Atomic_Node* next;	/**< Next node of the stack (managed by atomic module) **/
+} Atomic_Node;
+
+/**
+ * @brief Push a node on a stack.
+ * @param head Pointer to the head of the stack. Must be not NULL.
+ * @param node Pointer to the node. Must be not NULL and must not be on a stack already.
+ */
+void atomic_push(Atomic_Node* volatile* head, Atomic_Node* node);
+
+/**
+ * @brief Pop the top node of a stack.
+ * @param head Pointer to the head of the stack. Must be not NULL.
+ * @return Pointer to the node. Otherwise NULL if the stack is empty.
+ */
+Atomic_Node* atomic_pop(Atomic_Node* volatile* head);
+
+/**
+ * @brief Remove all nodes of a stack at once.
+ * @param head Pointer to the head of the stack. Must be not NULL.
+ * @return Pointer to the former top node (the nodes are linked in reverse push order). Otherwise NULL if the stack is empty.
+ */
+Atomic_Node* atomic_takeAll(Atomic_Node* volatile* head);
+
+/**
+ * @brief Add a value to a counter.
+ * @param value Pointer to the counter. Must be not NULL.
+ * @param add The value to add (can be negative).
+ */
+void atomic_add(volatile uint32_t* value, int32_t add);
+
+#endif // ATOMIC_H
@@ -0,0 +1,213 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file bcache.h
+ *
+ * @brief Buffer cache module. Caches blocks of block devices (DEV_DEVICE_TYPE_BLOCK) in memory,
+ * so repeated accesses (for example file system metadata) don't go to the medium every time.
+ * Sequential reads through streams (see bcache_readStream) prefetch following blocks asynchronously.
+ */
+
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <kernel.h>
+#include <dev.h>
+
+#define ERROR_BCACHE_OUT_OF_MEMORY	(ERROR_MODULE_DEFINED)
+#define ERROR_BCACHE_IO_FAILED		(ERROR_MODULE_DEFINED+1)
+
+/**
+ * @brief Default block size in bytes (used by kernel start).
+ */
+#ifndef BCACHE_BLOCK_SIZE
+#define BCACHE_BLOCK_SIZE 512
+#endif
+
+/**
+ * @brief Default number of cached blocks (used by kernel start).
+ */
+#ifndef BCACHE_BUFFER_COUNT
+#define BCACHE_BUFFER_COUNT 16
+#endif
+
+/**
+ * @brief Initial read-ahead window in blocks, the window is doubled by every sequential read of a stream.
+ */
+#ifndef BCACHE_READAHEAD_MIN
+#define BCACHE_READAHEAD_MIN 2
+#endif
+
+/**
+ * @brief Maximum read-ahead window in blocks (limited to half of the buffers).
+ */
+#ifndef BCACHE_READAHEAD_MAX
+#define BCACHE_READAHEAD_MAX 8
+#endif
+
+/**
+ * @brief Cached block. Returned by bcache_get, the data is valid until the buffer is released.
+ */
+typedef struct Bcache_Buffer
+{
+	Dev_Device* device;	/**< Device of the block **/
+	uint32_t block;		/**< Block number (device offset is block * block size) **/
+	uint8_t* data;		/**< Block data **/
+	bool dirty;			/**< Data was modified and isn't written to the device yet **/
+	uint32_t refCount;	/**< Number of users, referenced buffers are never evicted **/
+
+	//managed by buffer cache module
+	struct Bcache_Buffer* nextHash;		/**< Next buffer in the same hash bucket **/
+	struct Bcache_Buffer* prevLru;		/**< Previous buffer in LRU list (only if unreferenced) **/
+	struct Bcache_Buffer* nextLru;		/**< Next buffer in LRU list (only if unreferenced) **/
+	struct Bcache_Buffer* nextPrefetch;	/**< Next buffer in list of prefetches which aren't completed **/
+	bool prefetching;					/**< Block is read by a prefetch request **/
+	bool prefetched;					/**< Block was prefetched and isn't used yet **/
+	Dev_Request request;				/**< Prefetch request **/
+} Bcache_Buffer;
+
+/**
+ * @brief Read stream with adaptive read-ahead (see bcache_readStream). The memory is provided by the caller.
+ */
+typedef struct Bcache_Stream
+{
+	Dev_Device* device;			/**< Device of the stream **/
+	size_t nextOffset;			/**< Offset which continues the last read (sequential access) **/
+	uint32_t prefetchEnd;		/**< Block after the last prefetched block **/
+	size_t window;				/**< Current read-ahead window in blocks (0 if access isn't sequential) **/
+
+	//statistics
+	uint32_t reads;				/**< Number of reads **/
+	uint32_t sequentialReads;	/**< Number of reads which continued the previous read **/
+	uint32_t prefetchedBlocks;	/**< Number of blocks prefetched from the device by the stream (cached blocks aren't counted) **/
+	uint32_t prefetchHits;		/**< Number of read blocks which were prefetched **/
+} Bcache_Stream;
+
+/**
+ * @brief Buffer cache statistics.
+ */
+typedef struct Bcache_Stats
+{
+	size_t blockSize;		/**< Size of a block **/
+	size_t bufferCount;		/**< Number of buffers **/
+	size_t dirtyCount;		/**< Number of dirty buffers **/
+	uint32_t hits;			/**< Number of requests served from cache **/
+	uint32_t misses;		/**< Number of requests which had to read the device **/
+	uint32_t evictions;		/**< Number of evicted valid buffers **/
+	uint32_t writeBacks;	/**< Number of blocks written to devices **/
+	uint32_t prefetches;	/**< Number of prefetch requests **/
+	uint32_t prefetchWaits;	/**< Number of requests which had to wait for a prefetch **/
+} Bcache_Stats;
+
+/**
+ * @brief Initialize the buffer cache. Buffers of an earlier initialization are written back and released.
+ * Buffers of unregistered devices are written back and dropped automatically.
+ * @param blockSize Size of a block in bytes.
+ * @param bufferCount Number of cached blocks.
+ * @return ERROR_INVALID_ARGUMENT if blockSize or bufferCount is 0.
+ * ERROR_BCACHE_OUT_OF_MEMORY if buffer memory allocation failed.
+ * Otherwise ERROR_NONE.
+ */
+error_t bcache_init(size_t blockSize, size_t bufferCount);
+
+/**
+ * @brief Write back all dirty buffers and release the buffer memory.
+ */
+void bcache_deinit(void);
+
+/**
+ * @brief Get a block. The block is read from the device if it isn't cached.
+ * The least recently used unreferenced buffer is reused (written back before if it is dirty).
+ * @param device Pointer to a registered block device. Must be not NULL.
+ * @param block Block number.
+ * @return Referenced buffer of the block, must be released with bcache_release.
+ * Otherwise NULL if device isn't a block device, all buffers are referenced or the device operation failed.
+ */
+Bcache_Buffer* bcache_get(Dev_Device* device, uint32_t block);
+
+/**
+ * @brief Mark a referenced buffer as modified. It is written to the device at eviction or sync.
+ * @param buffer Buffer returned by bcache_get.
+ */
+void bcache_markDirty(Bcache_Buffer* buffer);
+
+/**
+ * @brief Release a buffer which was returned by bcache_get.
+ * @param buffer Buffer returned by bcache_get. bcache_release will do nothing if buffer is NULL.
+ */
+void bcache_release(Bcache_Buffer* buffer);
+
+/**
+ * @brief Write back all dirty buffers of a device.
+ * @param device Pointer to the device, NULL for all devices.
+ * @return ERROR_BCACHE_IO_FAILED if a block couldn't be written (the buffer stays dirty). Otherwise ERROR_NONE.
+ */
+error_t bcache_sync(Dev_Device* device);
+
+/**
+ * @brief Read bytes of a block device through the cache.
+ * @param device Pointer to a registered block device. Must be not NULL.
+ * @param buf Buffer to read into.
+ * @param size Number of bytes to read.
+ * @param offset Device offset.
+ * @return Number of bytes read (0 if the cache isn't initialized).
+ */
+size_t bcache_read(Dev_Device* device, void* buf, size_t size, size_t offset);
+
+/**
+ * @brief Write bytes of a block device through the cache (write-back, see bcache_sync).
+ * @param device Pointer to a registered block device. Must be not NULL.
+ * @param buf Buffer to write.
+ * @param size Number of bytes to write.
+ * @param offset Device offset.
+ * @return Number of bytes written into the cache (0 if the cache isn't initialized).
+ */
+size_t bcache_write(Dev_Device* device, const void* buf, size_t size, size_t offset);
+
+/**
+ * @brief Initialize a read stream.
+ * @param stream Pointer to the stream structure. Must be not NULL.
+ * @param device Pointer to a registered block device. Must be not NULL.
+ */
+void bcache_openStream(Bcache_Stream* stream, Dev_Device* device);
+
+/**
+ * @brief Read bytes through the cache from a stream. If the read continues the previous read of the stream,
+ * the following blocks are prefetched asynchronously (the window grows from BCACHE_READAHEAD_MIN to BCACHE_READAHEAD_MAX blocks).
+ * A non-sequential read resets the window. Devices without submit operation are prefetched synchronously.
+ * @param stream Pointer to an initialized stream. Must be not NULL.
+ * @param buf Buffer to read into.
+ * @param size Number of bytes to read.
+ * @param offset Device offset.
+ * @return Number of bytes read (0 if the cache isn't initialized).
+ */
+size_t bcache_readStream(Bcache_Stream* stream, void* buf, size_t size, size_t offset);
+
+/**
+ * @brief Returns stats of the buffer cache.
+ * @param outStats Returns the stats. Must be not NULL.
+ */
+void bcache_getStats(Bcache_Stats* outStats);
+
+#endif // BCACHE_H
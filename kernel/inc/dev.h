@@ -37,6 +37,45 @@
 #define ERROR_DEV_DEVICE_NOT_REGISTERED			(ERROR_MODULE_DEFINED+2)
 #define ERROR_DEV_HANDLER_NOT_REGISTERED		(ERROR_MODULE_DEFINED+3)
 #define ERROR_DEV_DEVICE_NAME_EXISTS_ALREADY	(ERROR_MODULE_DEFINED+4)
+#define ERROR_DEV_OPERATION_NOT_SUPPORTED		(ERROR_MODULE_DEFINED+5)
+#define ERROR_DEV_IO_FAILED						(ERROR_MODULE_DEFINED+6)
+
+/**
+ * @brief Number of buckets of the device hash table (must be a power of 2).
+ */
+#define DEV_HASH_TABLE_SIZE 32
+
+#ifdef DEVSTATS
+/**
+ * @brief Number of buckets of the latency histograms. Bucket n counts operations which took [2^n, 2^(n+1)) cycles
+ * (bucket 0 also counts 0 cycles), the last bucket counts all longer operations.
+ */
+#ifndef DEV_STATS_HISTOGRAM_SIZE
+#define DEV_STATS_HISTOGRAM_SIZE 24
+#endif
+
+/**
+ * @brief Statistics operation types.
+ */
+typedef enum DEV_STATS_OP
+{
+	DEV_STATS_OP_READ,	/**< read, readv and read requests**/
+	DEV_STATS_OP_WRITE,	/**< write, writev and write requests**/
+	DEV_STATS_OP_IOCTL,	/**< ioctl**/
+	DEV_STATS_OP_COUNT
+} DEV_STATS_OP;
+
+/**
+ * @brief Statistics of one operation type of a device.
+ */
+typedef struct Dev_OpStats
+{
+	uint32_t count;										/**< Number of operations **/
+	uint32_t errors;									/**< Number of failed operations (error code, or no byte transferred by a block device) **/
+	uint64_t bytes;										/**< Number of transferred bytes **/
+	uint32_t histogram[DEV_STATS_HISTOGRAM_SIZE];		/**< Log2 latency histogram in cycles (DWT cycle counter) **/
+} Dev_OpStats;
+#endif
 
 typedef enum DEV_DEVICE_EVENT
 {
@@ -50,6 +89,53 @@ typedef enum DEV_DEVICE_TYPE
 	DEV_DEVICE_TYPE_CHAR	/**< Read/Write operate on variable number of bytes**/
 } DEV_DEVICE_TYPE;
 
+typedef enum DEV_REQUEST_TYPE
+{
+	DEV_REQUEST_TYPE_READ,	/**< Read from device into buffer**/
+	DEV_REQUEST_TYPE_WRITE	/**< Write buffer to device**/
+} DEV_REQUEST_TYPE;
+
+typedef enum DEV_REQUEST_STATUS
+{
+	DEV_REQUEST_STATUS_PENDING,	/**< Request is submitted and not completed yet**/
+	DEV_REQUEST_STATUS_DONE		/**< Request is completed (see Dev_Request::error)**/
+} DEV_REQUEST_STATUS;
+
+struct Dev_Device;
+
+/**
+ * @brief Element of a scatter-gather vector (see dev_readv and dev_writev).
+ */
+typedef struct Dev_IoVec
+{
+	void* base;		/**< Buffer address **/
+	size_t size;	/**< Buffer size **/
+} Dev_IoVec;
+
+/**
+ * @brief Asynchronous I/O request (see dev_submit). The memory is provided by the caller and must stay valid until the request is completed.
+ */
+typedef struct Dev_Request
+{
+	DEV_REQUEST_TYPE type;							/**< Request type **/
+	void* buf;										/**< Buffer to read into or to write from **/
+	size_t size;									/**< Number of bytes to transfer **/
+	size_t offset;									/**< Device offset **/
+	void (*callback)(struct Dev_Request* request);	/**< Completion callback, called in the context of the completing driver (usually an interrupt handler), may be NULL **/
+	void* context;									/**< Caller data, not used by the device module **/
+
+	//set by device module and driver
+	struct Dev_Device* device;					/**< Device the request was submitted to **/
+#ifdef DEVSTATS
+	uint32_t submitCycle;						/**< Cycle counter at dev_submit (latency statistics) **/
+	bool timed;									/**< Request was submitted with dev_submit and is counted at completion **/
+#endif
+	volatile DEV_REQUEST_STATUS status;			/**< Request status **/
+	size_t transferred;							/**< Number of transferred bytes (valid if completed) **/
+	error_t error;								/**< Result of the request (valid if completed) **/
+	struct Dev_Request* next;					/**< Free for use by the driver while the request is pending (for example request queues) **/
+} Dev_Request;
+
 typedef struct Dev_Device
 {
 	const char* name;		/**< Name of the device (for example 'dma') **/
@@ -60,6 +146,18 @@ typedef struct Dev_Device
 	size_t (*read)(struct Dev_Device*, void* buf, size_t size, size_t offset);			/**< Function pointer to read operation handler (if device doesn't support this operation, it must be NULL)**/
 	size_t (*write)(struct Dev_Device*, const void* buf, size_t size, size_t offset);	/**< Function pointer to write operation handler (if device doesn't support this operation, it must be NULL)**/
 	error_t (*ioctl)(struct Dev_Device*, uint32_t num, void* args);						/**< Function pointer to io-control operation handler (if device doesn't support this operation, it must be NULL)**/
+	size_t (*readv)(struct Dev_Device*, const Dev_IoVec* vec, size_t count, size_t offset);	/**< Function pointer to vectored read operation handler, reads into the buffers in order (if device doesn't support this operation, it must be NULL)**/
+	size_t (*writev)(struct Dev_Device*, const Dev_IoVec* vec, size_t count, size_t offset);	/**< Function pointer to vectored write operation handler, writes the buffers in order (if device doesn't support this operation, it must be NULL)**/
+	error_t (*map)(struct Dev_Device*, size_t offset, size_t size, void** outAddr, size_t* outSize);	/**< Function pointer to map operation handler, lends a pointer into directly addressable device memory (if device doesn't support this operation, it must be NULL)**/
+	void (*unmap)(struct Dev_Device*, void* addr, size_t size);							/**< Function pointer to unmap operation handler, releases a mapping (NULL if mappings need no release)**/
+	error_t (*submit)(struct Dev_Device*, Dev_Request* request);						/**< Function pointer to asynchronous request handler, the driver completes the request with dev_completeRequest (if device doesn't support this operation, it must be NULL)**/
+
+	//managed by device module
+	uint32_t nameHash;				/**< Hash of name (set by dev_registerDevice) **/
+	struct Dev_Device* nextHash;	/**< Next device in the same hash bucket (set by dev_registerDevice) **/
+#ifdef DEVSTATS
+	Dev_OpStats stats[DEV_STATS_OP_COUNT];	/**< Operation statistics (reset by dev_registerDevice) **/
+#endif
 } Dev_Device;
 
 /**
@@ -79,11 +177,10 @@ void dev_init(void);
 void dev_deinit(void);
 
 /**
- * @brief Drivers register their devices here.
- * @param device Pointer to a initialzed and valid Dev_Device structure. Must be not NULL.
+ * @brief Drivers register their devices here. The device structure is linked into the device table directly, no memory is allocated.
+ * @param device Pointer to a initialzed and valid Dev_Device structure. Must be not NULL and stay valid until the device is unregistered.
  * @return ERROR_DEV_INVALID_DEVICE_STRUCTURE if Dev_Device structure contains invalid values.
  * ERROR_DEV_DEVICE_NAME_EXISTS_ALREADY if a device with the same device name (name + number) is already registered.
- * ERROR_DEV_MEMORY_ALLOCATION_FAILED if memory allocation failed.
  * Otherwise ERROR_NONE.
  */
 error_t dev_registerDevice(Dev_Device* device);
@@ -97,6 +194,134 @@ error_t dev_registerDevice(Dev_Device* device);
  */
 error_t dev_unregisterDevice(Dev_Device* device);
 
+/**
+ * @brief Find a registered device by its device name.
+ * @param name Name of the device (for example 'dma'). Must be not NULL.
+ * @param number Number of the device.
+ * @return Pointer to the device.
+ * Otherwise NULL if no device with this name and number is registered.
+ */
+Dev_Device* dev_find(const char* name, uint32_t number);
+
+/**
+ * @brief Submit an asynchronous I/O request. The request is completed by the driver (see dev_completeRequest).
+ * If the device has no submit operation, the request is executed synchronously by its read or write operation and completed before dev_submit returns.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param request Pointer to the request with type, buf, size, offset, callback and context set. Must be not NULL.
+ * @return ERROR_INVALID_ADDRESS if buf is NULL.
+ * ERROR_DEV_OPERATION_NOT_SUPPORTED if the device supports neither asynchronous requests nor the requested operation.
+ * Otherwise the result of the driver's submit operation (ERROR_NONE if request was accepted).
+ */
+error_t dev_submit(Dev_Device* device, Dev_Request* request);
+
+/**
+ * @brief Complete a submitted request. Called by drivers, usually from their interrupt handler.
+ * The completion callback of the request is called.
+ * @param request Pointer to the completed request.
+ * @param transferred Number of transferred bytes.
+ * @param error ERROR_NONE if the request was successful, otherwise the error code.
+ */
+void dev_completeRequest(Dev_Request* request, size_t transferred, error_t error);
+
+/**
+ * @brief Read from a device synchronously. Uses the read operation of the device, or submits a request and waits for its completion.
+ * Must not be called from an interrupt handler if the device has no read operation.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param buf Buffer to read into.
+ * @param size Number of bytes to read.
+ * @param offset Device offset.
+ * @return Number of bytes read (0 if the operation isn't supported or failed).
+ */
+size_t dev_read(Dev_Device* device, void* buf, size_t size, size_t offset);
+
+/**
+ * @brief Write to a device synchronously. Uses the write operation of the device, or submits a request and waits for its completion.
+ * Must not be called from an interrupt handler if the device has no write operation.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param buf Buffer to write.
+ * @param size Number of bytes to write.
+ * @param offset Device offset.
+ * @return Number of bytes written (0 if the operation isn't supported or failed).
+ */
+size_t dev_write(Dev_Device* device, const void* buf, size_t size, size_t offset);
+
+/**
+ * @brief Call the io-control operation of a device.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param num Io-control number.
+ * @param args Io-control arguments.
+ * @return ERROR_DEV_OPERATION_NOT_SUPPORTED if the device has no ioctl operation.
+ * Otherwise the result of the driver's ioctl operation.
+ */
+error_t dev_ioctl(Dev_Device* device, uint32_t num, void* args);
+
+/**
+ * @brief Read from a device into several buffers (scatter). The buffers are filled in order starting at offset.
+ * Uses the readv operation of the device, otherwise every buffer is read with dev_read.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param vec Array of buffers.
+ * @param count Number of buffers.
+ * @param offset Device offset.
+ * @return Number of bytes read. Stops at the first buffer which isn't filled completely.
+ */
+size_t dev_readv(Dev_Device* device, const Dev_IoVec* vec, size_t count, size_t offset);
+
+/**
+ * @brief Write several buffers to a device (gather). The buffers are written in order starting at offset.
+ * Uses the writev operation of the device, otherwise every buffer is written with dev_write.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param vec Array of buffers.
+ * @param count Number of buffers.
+ * @param offset Device offset.
+ * @return Number of bytes written. Stops at the first buffer which isn't written completely.
+ */
+size_t dev_writev(Dev_Device* device, const Dev_IoVec* vec, size_t count, size_t offset);
+
+/**
+ * @brief Map device memory (zero-copy access to memory-backed devices, for example ROM images).
+ * The memory must be released with dev_unmap. Memory of read-only devices must not be written.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param offset Device offset.
+ * @param size Number of bytes to map.
+ * @param outAddr Returns the address of the mapped memory. Must be not NULL.
+ * @param outSize Returns the number of mapped bytes, may be less than size (for example at the end of the device). Must be not NULL.
+ * @return ERROR_DEV_OPERATION_NOT_SUPPORTED if the device has no map operation.
+ * Otherwise the result of the driver's map operation (ERROR_NONE if memory was mapped).
+ */
+error_t dev_map(Dev_Device* device, size_t offset, size_t size, void** outAddr, size_t* outSize);
+
+/**
+ * @brief Release memory which was mapped by dev_map.
+ * @param device Pointer to the device. Must be not NULL.
+ * @param addr Address returned by dev_map.
+ * @param size Size returned by dev_map.
+ */
+void dev_unmap(Dev_Device* device, void* addr, size_t size);
+
+#ifdef DEVSTATS
+/**
+ * @brief Returns the statistics of an operation type of a device.
+ * Operations through dev_read, dev_write, dev_readv, dev_writev, dev_ioctl and requests are counted.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param op Operation type.
+ * @return Pointer to the statistics. Otherwise NULL if op is invalid.
+ */
+const Dev_OpStats* dev_getStats(const Dev_Device* device, DEV_STATS_OP op);
+
+/**
+ * @brief Reset the statistics of a device.
+ * @param device Pointer to a registered device. Must be not NULL.
+ */
+void dev_resetStats(Dev_Device* device);
+
+#ifdef DEBUG
+/**
+ * @brief Print the statistics of all registered devices with debug_printf.
+ */
+void dev_dumpStats(void);
+#endif
+#endif
+
 /**
  * @brief Register an event handler. Registered event handlers will be called when a new device is registered or a device is unregistered (in this case handler will be called before device is removed from list).
  * It is allowed to register the same event handler more than once.
@@ -107,6 +332,18 @@ error_t dev_unregisterDevice(Dev_Device* device);
  */
 error_t dev_registerEventHandler(Dev_EventHandler handler);
 
+/**
+ * @brief Register an event handler which is called deferred by the kernel work queue instead of the registration call,
+ * so slow handlers don't stall device registration. Events are delivered in the order they occurred.
+ * The Dev_Device structure of an unregistered device must stay valid until its DEV_DEVICE_EVENT_UNREGISTERED event was delivered.
+ * It is allowed to register the same event handler more than once.
+ * @param handler Event handler.
+ * @return ERROR_INVALID_ADDRESS if handler is NULL.
+ * ERROR_DEV_MEMORY_ALLOCATION_FAILED if memory allocation failed.
+ * Otherwise ERROR_NONE.
+ */
+error_t dev_registerDeferredEventHandler(Dev_EventHandler handler);
+
 /**
  * @brief Unregister an event handler.
  * @param handler Event handler.
@@ -0,0 +1,93 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file devbench.h
+ *
+ * @brief Device benchmark module. Drives a device through the device layer with sequential or random access patterns
+ * and measures throughput and cycles per call with the DWT cycle counter.
+ */
+
+#ifndef DEVBENCH_H
+#define DEVBENCH_H
+
+#include <dev.h>
+
+/**
+ * @brief Size of the RAM disk used by devbench_runSuite in bytes.
+ */
+#ifndef DEVBENCH_RAM_SIZE
+#define DEVBENCH_RAM_SIZE (16*1024)
+#endif
+
+typedef enum DEVBENCH_OP
+{
+	DEVBENCH_OP_READ,	/**< dev_read **/
+	DEVBENCH_OP_WRITE	/**< dev_write **/
+} DEVBENCH_OP;
+
+typedef enum DEVBENCH_PATTERN
+{
+	DEVBENCH_PATTERN_SEQUENTIAL,	/**< Offsets increase by the transfer size and wrap around at the end of the span **/
+	DEVBENCH_PATTERN_RANDOM			/**< Pseudo random offsets (aligned to the transfer size) within the span **/
+} DEVBENCH_PATTERN;
+
+/**
+ * @brief Result of a benchmark run.
+ */
+typedef struct Devbench_Result
+{
+	uint32_t calls;				/**< Number of calls **/
+	uint32_t bytes;				/**< Number of transferred bytes **/
+	uint32_t cycles;			/**< Cycles of all calls **/
+	uint32_t cyclesPerCall;		/**< Average cycles per call **/
+	uint32_t kibPerSecond;		/**< Throughput in KiB per second at the current core clock (0 if less than 1 KiB was transferred) **/
+} Devbench_Result;
+
+/**
+ * @brief Run a benchmark on a device.
+ * @param device Pointer to a registered device. Must be not NULL.
+ * @param op Operation.
+ * @param pattern Access pattern.
+ * @param buf Buffer to read into or to write from with at least size bytes. Must be not NULL.
+ * @param size Transfer size of one call in bytes. Must be greater than 0.
+ * @param span Size of the accessed device area in bytes, starting at offset 0 (0 for offset 0 only, for example char devices).
+ * @param calls Number of calls.
+ * @param result Pointer to the result. Must be not NULL.
+ * @return ERROR_INVALID_ARGUMENT if size or calls is 0.
+ * ERROR_DEV_OPERATION_NOT_SUPPORTED if the device doesn't support the operation.
+ * Otherwise ERROR_NONE.
+ */
+error_t devbench_run(Dev_Device* device, DEVBENCH_OP op, DEVBENCH_PATTERN pattern, void* buf, size_t size, size_t span, uint32_t calls, Devbench_Result* result);
+
+#ifdef DEBUG
+/**
+ * @brief Benchmark the built-in devices (see memdev.h) with sequential and random patterns and print the results with debug_printf.
+ * A RAM disk with DEVBENCH_RAM_SIZE bytes is registered for the run, the devices 'null0' and 'zero0' are benchmarked if registered.
+ * @return ERROR_HEAP_OUT_OF_MEMORY if the RAM disk or buffer can't be allocated.
+ * Otherwise error code of the first failed run or ERROR_NONE.
+ */
+error_t devbench_runSuite(void);
+#endif
+
+#endif // DEVBENCH_H
@@ -32,25 +32,264 @@
 
 #include <kernel.h>
 
+#define ERROR_HEAP_NO_ISR_POOL_LEFT	(ERROR_MODULE_DEFINED)
+#define ERROR_HEAP_OUT_OF_MEMORY	(ERROR_MODULE_DEFINED+1)
+
+/**
+ * @brief Maximum number of interrupt pools (see heap_reserveIsrPool).
+ */
+#define HEAP_ISR_POOL_COUNT 4
+
+/**
+ * @brief Maximum number of movable allocations (see heap_allocMovable).
+ */
+#define HEAP_HANDLE_COUNT 32
+
+/**
+ * @brief Maximum number of allocation owners (see heap_registerOwner).
+ */
+#define HEAP_OWNER_COUNT 16
+
+/**
+ * @brief Owner of allocations which are not assigned to a registered owner.
+ */
+#define HEAP_OWNER_NONE 0
+
+/**
+ * @brief Allocation attributes (can be combined). Memory is only allocated from regions which provide all requested attributes.
+ */
+typedef enum HEAP_ATTR
+{
+	HEAP_ATTR_ANY	= DEVICE_MEMORY_ATTR_NONE,	/**< Memory from any region */
+	HEAP_ATTR_FAST	= DEVICE_MEMORY_ATTR_FAST,	/**< Memory from a fast region (for example CCM) */
+	HEAP_ATTR_DMA	= DEVICE_MEMORY_ATTR_DMA	/**< Memory which is accessible by DMA controllers */
+} HEAP_ATTR;
+
+/**
+ * @brief Heap statistics (see heap_getDetailedStats).
+ */
+typedef struct Heap_Stats
+{
+	size_t heapSize;			/**< Size of all heap regions **/
+	size_t allocMem;			/**< Size of allocated memory (including block headers and region control structures) **/
+	size_t freeMem;				/**< Size of free memory **/
+	size_t peakAllocMem;		/**< Highest value of allocMem since heap initialization (high-water mark) **/
+	size_t largestFreeBlock;	/**< Size of the largest free block (within 1/16 of the exact value) **/
+	size_t freeBlockCount;		/**< Number of free blocks **/
+	size_t allocFailCount;		/**< Number of failed allocation requests **/
+	size_t movedMem;			/**< Number of bytes moved by heap compaction since heap initialization **/
+	uint32_t fragmentation;		/**< Fragmentation index in per mille (1000 - 1000 * largestFreeBlock / freeMem, regions count as separate blocks) **/
+} Heap_Stats;
+
+/**
+ * @brief Allocation statistics of an owner (see heap_getOwnerStats).
+ */
+typedef struct Heap_OwnerStats
+{
+	const char* name;	/**< Name of the owner **/
+	size_t liveMem;		/**< Size of all allocated blocks of the owner (including block headers) **/
+	size_t peakMem;		/**< Highest value of liveMem since heap initialization **/
+	size_t blockCount;	/**< Number of allocated blocks of the owner **/
+	size_t allocCount;	/**< Number of allocation requests (including heap_realloc) since heap initialization **/
+} Heap_OwnerStats;
+
+/**
+ * @brief Handle of a movable allocation (see heap_allocMovable).
+ */
+typedef struct Heap_Movable* Heap_Handle;
+
+#ifdef HEAPTRACE
+/**
+ * @brief Number of entries in the allocation trace ring buffer.
+ */
+#ifndef HEAP_TRACE_ENTRY_COUNT
+#define HEAP_TRACE_ENTRY_COUNT 128
+#endif
+
+/**
+ * @brief Allocation trace entry types.
+ */
+typedef enum HEAP_TRACE_TYPE
+{
+	HEAP_TRACE_ALLOC,			/**< heap_alloc or heap_allocAttr (arg = attributes) */
+	HEAP_TRACE_ALLOC_ALIGNED,	/**< heap_allocAligned (arg = alignLog2<<16 | attributes) */
+	HEAP_TRACE_REALLOC,			/**< heap_realloc (oldMem = address passed to heap_realloc) */
+	HEAP_TRACE_FREE,			/**< heap_free in thread mode (oldMem = freed address) */
+	HEAP_TRACE_POOL_ALLOC,		/**< Block allocated to refill an interrupt pool (arg = attributes) */
+	HEAP_TRACE_DEFERRED_FREE,	/**< Release of a block which was freed in handler mode (oldMem = freed address) */
+	HEAP_TRACE_ALLOC_MOVABLE,	/**< heap_allocMovable (arg = attributes, mem = handle) */
+	HEAP_TRACE_FREE_MOVABLE,	/**< heap_freeMovable (oldMem = handle) */
+	HEAP_TRACE_COMPACT			/**< heap_compact (size = moved bytes) */
+} HEAP_TRACE_TYPE;
+
+/**
+ * @brief Allocation trace entry. Recorded by every heap allocation function if HEAPTRACE is defined.
+ * Interrupt handlers don't record entries, their blocks appear as pool refills and deferred frees,
+ * so the entries describe every change of the heap blocks (movable blocks are identified by their handles).
+ */
+typedef struct Heap_TraceEntry
+{
+	HEAP_TRACE_TYPE type;	/**< Entry type **/
+	uint32_t timestamp;		/**< DWT cycle counter value at call **/
+	uint32_t cycles;		/**< Duration of the call in cycles **/
+	const void* caller;		/**< Return address of the call **/
+	size_t size;			/**< Requested size **/
+	uint32_t arg;			/**< Type specific argument (see HEAP_TRACE_TYPE) **/
+	const void* mem;		/**< Returned address **/
+	const void* oldMem;		/**< Freed or reallocated address **/
+} Heap_TraceEntry;
+#endif
+
 /**
  * @brief Initialize the heap memory.
+ * Every memory section of device_memoryMap becomes a heap region (without the memory used by the kernel image).
  */
 void heap_init(void);
 
 /**
  * @brief Allocate memory with specified size from heap.
+ * Can be called from interrupt handlers, the memory is taken from the smallest suitable interrupt pool in this case (see heap_reserveIsrPool).
  * @param size The size of the needed memory.
  * @return A valid address to the memory block.
  * Otherwise NULL if no memory or memory with the specified size is aviable.
  */
 void* heap_alloc(size_t size);
 
+/**
+ * @brief Allocate memory with specified size and attributes from heap.
+ * Can be called from interrupt handlers, the memory is taken from the smallest suitable interrupt pool in this case (see heap_reserveIsrPool).
+ * @param size The size of the needed memory.
+ * @param attributes The required memory attributes (see HEAP_ATTR).
+ * @return A valid address to the memory block.
+ * Otherwise NULL if no memory with the specified size and attributes is aviable.
+ */
+void* heap_allocAttr(size_t size, uint32_t attributes);
+
+/**
+ * @brief Allocate memory with specified size, alignment and attributes from heap. Returns NULL if called from an interrupt handler.
+ * Power of two sized blocks which are aligned to their size can be used as MPU region (see MPU_Region),
+ * for example heap_allocAligned(1<<n, n, HEAP_ATTR_ANY) for a region with MPU_Region::size = n.
+ * @param size The size of the needed memory.
+ * @param alignLog2 Log2 of the required alignment (address is a multiple of 1<<alignLog2).
+ * @param attributes The required memory attributes (see HEAP_ATTR).
+ * @return A valid, aligned address to the memory block (can be freed with heap_free).
+ * Otherwise NULL if no memory with the specified size, alignment and attributes is aviable.
+ */
+void* heap_allocAligned(size_t size, uint32_t alignLog2, uint32_t attributes);
+
 /**
  * @brief Free the memory which was allocated from heap.
+ * Can be called from interrupt handlers, the memory is released at the next heap call in thread mode in this case.
  * @param mem The address from the memory. heap_free will do nothing if mem is NULL.
  */
 void heap_free(void* mem);
 
+/**
+ * @brief Allocate movable memory with specified size and attributes from heap. Must be called in thread mode.
+ * The memory is only accessible while it is pinned (see heap_pin), unpinned memory may be moved by heap compaction.
+ * Compaction is done automatically if an allocation fails, movable memory should be used for large long-living buffers.
+ * @param size The size of the needed memory.
+ * @param attributes The required memory attributes (see HEAP_ATTR).
+ * @return Handle of the memory.
+ * Otherwise NULL if no memory or memory with the specified size is aviable or all HEAP_HANDLE_COUNT handles are used.
+ */
+Heap_Handle heap_allocMovable(size_t size, uint32_t attributes);
+
+/**
+ * @brief Free movable memory. The handle becomes invalid. Must be called in thread mode.
+ * @param handle Handle of the memory. heap_freeMovable will do nothing if handle is NULL.
+ */
+void heap_freeMovable(Heap_Handle handle);
+
+/**
+ * @brief Pin movable memory, it won't be moved until it is unpinned. Pins can be nested.
+ * Must not be called in handler mode while the heap is used in thread mode.
+ * @param handle Valid handle of the memory.
+ * @return Address of the memory, valid until the matching heap_unpin call.
+ */
+void* heap_pin(Heap_Handle handle);
+
+/**
+ * @brief Unpin movable memory which was pinned by heap_pin.
+ * @param handle Valid handle of the memory.
+ */
+void heap_unpin(Heap_Handle handle);
+
+/**
+ * @brief Compact the heap: unpinned movable memory is moved down, so free blocks are merged. Must be called in thread mode.
+ * @return Number of moved bytes.
+ */
+size_t heap_compact(void);
+
+/**
+ * @brief Register an allocation owner (for example a kernel module). Registering an existing name returns its owner ID again.
+ * @param name Name of the owner, must stay valid (for example the moduleName string of a module).
+ * @return ID of the owner.
+ * Otherwise HEAP_OWNER_NONE if all HEAP_OWNER_COUNT owners are registered.
+ */
+uint32_t heap_registerOwner(const char* name);
+
+/**
+ * @brief Set the owner of following allocations in thread mode (allocations in handler mode have no owner).
+ * A module sets its owner before it allocates memory and restores the previous owner afterwards.
+ * @param owner ID of a registered owner or HEAP_OWNER_NONE. Invalid IDs are ignored.
+ * @return ID of the previous owner.
+ */
+uint32_t heap_setCurrentOwner(uint32_t owner);
+
+/**
+ * @brief Assign allocated memory to an owner. Must be called in thread mode.
+ * @param mem Address of memory which was allocated from heap.
+ * @param owner ID of a registered owner or HEAP_OWNER_NONE.
+ * @return ERROR_INVALID_ARGUMENT if mem is NULL, owner is invalid or the function is called in handler mode.
+ * Otherwise ERROR_NONE.
+ */
+error_t heap_setOwner(void* mem, uint32_t owner);
+
+/**
+ * @brief Returns the number of registered owners (including HEAP_OWNER_NONE), owner IDs are 0 to count-1.
+ */
+size_t heap_getOwnerCount(void);
+
+/**
+ * @brief Returns allocation statistics of an owner.
+ * @param owner ID of the owner.
+ * @param outStats Returns the stats. Must be not NULL.
+ * @return ERROR_INVALID_INDEX if owner isn't registered. Otherwise ERROR_NONE.
+ */
+error_t heap_getOwnerStats(uint32_t owner, Heap_OwnerStats* outStats);
+
+/**
+ * @brief Reserve blocks for allocations in interrupt handlers. Must be called in thread mode.
+ * Interrupt handlers can't use the general allocator, they take preallocated blocks from lock-free pools instead.
+ * Blocks taken by interrupt handlers are replaced at the next heap call in thread mode.
+ * @param size Block size of the pool. Interrupt allocations are served by the smallest pool with sufficient block size.
+ * @param count Number of blocks to reserve additionally. Calls with the same size and attributes add to the same pool.
+ * @param attributes The memory attributes of the blocks (see HEAP_ATTR).
+ * @return ERROR_INVALID_ARGUMENT if size is 0 or the function is called in handler mode.
+ * ERROR_HEAP_NO_ISR_POOL_LEFT if all HEAP_ISR_POOL_COUNT pools are in use.
+ * ERROR_HEAP_OUT_OF_MEMORY if not all blocks could be reserved (missing blocks are reserved later).
+ * Otherwise ERROR_NONE.
+ */
+error_t heap_reserveIsrPool(size_t size, size_t count, uint32_t attributes);
+
+/**
+ * @brief Release memory which was freed in interrupt handlers and refill interrupt pools.
+ * Done by every heap call in thread mode, call it if no other heap calls are expected. Does nothing in handler mode.
+ */
+void heap_processDeferred(void);
+
+/**
+ * @brief Change the size of memory which was allocated from heap. Returns NULL if called from an interrupt handler.
+ * The block is resized in place if possible (shrinking or growing into the following free block),
+ * otherwise a new block with the attributes requested by the original allocation is allocated and the content is copied.
+ * @param mem The address from the memory. heap_realloc behaves like heap_alloc if mem is NULL.
+ * @param size The new size of the memory. heap_realloc behaves like heap_free and returns NULL if size is 0.
+ * @return A valid address to the resized memory block (content is preserved up to the lesser of old and new size).
+ * Otherwise NULL if no memory with the specified size is aviable, mem stays valid in this case.
+ */
+void* heap_realloc(void* mem, size_t size);
+
 /**
  * @brief Returns stats of heap.
  * @param outHeapSize Returns the heap size if outHeapSize isn't NULL.
@@ -59,5 +298,52 @@ void heap_free(void* mem);
  */
 void heap_getStats(size_t* outHeapSize, size_t* outAllocMem, size_t* outFreeMem);
 
+/**
+ * @brief Returns detailed stats of heap. All values are kept up to date by the allocator, the call takes constant time.
+ * @param outStats Returns the stats. Must be not NULL.
+ */
+void heap_getDetailedStats(Heap_Stats* outStats);
+
+/**
+ * @brief Returns the number of heap regions.
+ */
+size_t heap_getRegionCount(void);
+
+/**
+ * @brief Returns stats of a heap region.
+ * @param index Index of the region.
+ * @param outAttributes Returns the region attributes (see HEAP_ATTR) if outAttributes isn't NULL.
+ * @param outRegionSize Returns the region size if outRegionSize isn't NULL.
+ * @param outAllocMem Returns the size of allocated memory if outAllocMem isn't NULL.
+ * @param outFreeMem Returns the size of free memory if outFreeMem isn't NULL.
+ * @return ERROR_INVALID_INDEX if index is not lesser than heap_getRegionCount().
+ * Otherwise ERROR_NONE.
+ */
+error_t heap_getRegionStats(size_t index, uint32_t* outAttributes, size_t* outRegionSize, size_t* outAllocMem, size_t* outFreeMem);
+
+#ifdef HEAPTRACE
+/**
+ * @brief Returns the number of recorded trace entries (including entries which were overwritten in the ring buffer).
+ */
+size_t heap_getTraceCount(void);
+
+/**
+ * @brief Returns a trace entry.
+ * @param index Index of the entry (0 = first recorded entry).
+ * @return The trace entry.
+ * Otherwise NULL if the entry was not recorded yet or has been overwritten.
+ */
+const Heap_TraceEntry* heap_getTraceEntry(size_t index);
+
+#ifdef DEBUG
+/**
+ * @brief Print all aviable trace entries with debug_printf, one line per entry:
+ * "heaptrace <type> <timestamp> <cycles> <caller> <size> <arg> <mem> <oldMem>" (numbers are hexadecimal).
+ * The output can be replayed on the host with kernel/host/bin/heapreplay.
+ */
+void heap_dumpTrace(void);
+#endif
+#endif
+
 #endif // HEAP_H
 
@@ -0,0 +1,77 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file intbench.h
+ *
+ * @brief Interrupt benchmark module. Measures the interrupt entry latency of handlers installed with int_setHandler,
+ * from pending an IRQ by software to the first statement of its handler.
+ */
+
+#ifndef INTBENCH_H
+#define INTBENCH_H
+
+#include <kernel.h>
+
+#define ERROR_INTBENCH_NO_COUNTER (ERROR_MODULE_DEFINED)
+#define ERROR_INTBENCH_NOT_DELIVERED (ERROR_MODULE_DEFINED+1)
+
+/**
+ * @brief Result of a benchmark run.
+ */
+typedef struct Intbench_Result
+{
+	uint32_t samples;			/**< Number of delivered interrupts **/
+	uint32_t minCycles;			/**< Minimum entry latency in cycles **/
+	uint32_t avgCycles;			/**< Average entry latency in cycles **/
+	uint32_t maxCycles;			/**< Maximum entry latency in cycles **/
+	uint32_t overheadCycles;	/**< Cycles of reading the counter, subtracted from every sample **/
+	bool sysTick;				/**< The DWT cycle counter doesn't run (for example under QEMU), SysTick was used instead **/
+} Intbench_Result;
+
+/**
+ * @brief Measure the entry latency of an IRQ. A handler is installed for the run (see int_setHandler) which records the cycle counter
+ * (DWT->CYCCNT, or SysTick if the DWT cycle counter doesn't run) at entry, the IRQ is pended through the NVIC software trigger.
+ * The handler is uninstalled and the IRQ disabled afterwards.
+ * Must be called in thread mode.
+ * @param irqNum IRQ number of an unused IRQ (0 or greater).
+ * @param priority Priority of the IRQ.
+ * @param samples Number of interrupts.
+ * @param result Pointer to the result. Must be not NULL.
+ * @return ERROR_INVALID_ARGUMENT if samples is 0 or irqNum is negative.
+ * Error code of int_setHandler if the handler can't be installed.
+ * ERROR_INTBENCH_NO_COUNTER if neither the DWT cycle counter nor SysTick runs.
+ * ERROR_INTBENCH_NOT_DELIVERED if a pended IRQ isn't taken.
+ * Otherwise ERROR_NONE.
+ */
+error_t intbench_run(int32_t irqNum, uint8_t priority, uint32_t samples, Intbench_Result* result);
+
+#ifdef DEBUG
+/**
+ * @brief Benchmark the entry latency of an unused IRQ of the device and print the result with debug_printf.
+ * @return Error code of intbench_run.
+ */
+error_t intbench_runSuite(void);
+#endif
+
+#endif // INTBENCH_H
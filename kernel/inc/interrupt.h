@@ -77,6 +77,24 @@
 #define INT_SOFTWARE_AVERAGE_PRIORITY (INT_PRIORITY_LOWEST-1)
 #define INT_SOFTWARE_LOW_PRIORITY (INT_PRIORITY_LOWEST)
 
+/**
+ * @brief Kernel ceiling priority. Kernel critical sections (see int_enterCritical) mask all interrupts with this or a lower priority.
+ * Interrupts with a higher priority (lower value) are never delayed by the kernel, their handlers must not call kernel functions
+ * except lock-free ones (for example softirq_post).
+ */
+#ifndef INT_KERNEL_CEILING_PRIORITY
+#define INT_KERNEL_CEILING_PRIORITY 4
+#endif
+
+#if INT_KERNEL_CEILING_PRIORITY < 1 || INT_KERNEL_CEILING_PRIORITY > INT_SOFTWARE_HIGH_PRIORITY
+#error "INT_KERNEL_CEILING_PRIORITY must be between 1 and INT_SOFTWARE_HIGH_PRIORITY"
+#endif
+
+/**
+ * @brief Interrupt handler.
+ */
+typedef void (*Int_Handler)(void);
+
 /**
  * @brief System interrupt types.
  */
@@ -121,5 +139,30 @@ void int_enable(int32_t irqNum, uint8_t priority);
  */
 void int_disable(int32_t irqNum);
 
+/**
+ * @brief Installs or uninstalls the handler of an interrupt. The handler is written into the vector table in RAM,
+ * so it is called directly by the hardware (no dispatching in software). The interrupt is not enabled (see int_enable).
+ * @param irqNum The irq number of the interrupt (or a system interrupt type except INT_RESET, see INT_TYPE).
+ * @param handler The handler. NULL uninstalls the current handler (unhandled interrupts cause a kernel panic).
+ * @return ERROR_INVALID_INDEX if the irq number is invalid.
+ * ERROR_INT_ALREADY_IN_USE if handler is not NULL and another handler is installed already.
+ * ERROR_INT_NOT_USED_YET if handler is NULL and no handler is installed.
+ * Otherwise ERROR_NONE.
+ */
+error_t int_setHandler(int32_t irqNum, Int_Handler handler);
+
+/**
+ * @brief Enters a kernel critical section by raising the interrupt mask (BASEPRI) to INT_KERNEL_CEILING_PRIORITY.
+ * Interrupts with a higher priority than the ceiling stay enabled. Critical sections can be nested, also in interrupt handlers.
+ * @return The previous interrupt mask which must be passed to int_exitCritical.
+ */
+uint32_t int_enterCritical(void);
+
+/**
+ * @brief Leaves a kernel critical section.
+ * @param state The interrupt mask returned by the matching int_enterCritical call.
+ */
+void int_exitCritical(uint32_t state);
+
 #endif // INTERRUPT_H
 
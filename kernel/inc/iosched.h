@@ -0,0 +1,107 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file iosched.h
+ *
+ * @brief I/O scheduler module. Queues requests (see Dev_Request) of a block device, sorts them by offset
+ * and merges adjacent requests into one vectored operation (multi-block transfer).
+ *
+ * Merging only saves device commands if the driver implements Dev_Device::readv and Dev_Device::writev.
+ * None of the current drivers does, so dev_readv and dev_writev fall back to one dev_read or dev_write per request
+ * and a merged run costs as many device operations as the single requests.
+ */
+
+#ifndef IOSCHED_H
+#define IOSCHED_H
+
+#include <kernel.h>
+#include <dev.h>
+
+/**
+ * @brief Maximum number of queued requests, the queue is dispatched when it is full.
+ */
+#ifndef IOSCHED_QUEUE_DEPTH_MAX
+#define IOSCHED_QUEUE_DEPTH_MAX 16
+#endif
+
+/**
+ * @brief Maximum number of requests which are merged into one operation.
+ */
+#ifndef IOSCHED_MERGE_MAX
+#define IOSCHED_MERGE_MAX 8
+#endif
+
+typedef enum IOSCHED_POLICY
+{
+	IOSCHED_POLICY_NOOP,	/**< Requests are passed to the device immediately**/
+	IOSCHED_POLICY_ELEVATOR	/**< Requests are queued until dispatch, sorted by offset and adjacent requests are merged**/
+} IOSCHED_POLICY;
+
+/**
+ * @brief Request queue of a device. The structure is managed by the scheduler module, callers only provide its memory.
+ */
+typedef struct Iosched_Queue
+{
+	Dev_Device* device;		/**< Device of the queue **/
+	IOSCHED_POLICY policy;	/**< Scheduling policy **/
+	Dev_Request* requests;	/**< Queued requests sorted by offset (linked by Dev_Request::next) **/
+	size_t position;		/**< Device offset after the last dispatched operation (elevator position) **/
+
+	//statistics
+	size_t depth;			/**< Number of queued requests **/
+	size_t maxDepth;		/**< Highest number of queued requests **/
+	uint32_t submitted;		/**< Number of submitted requests **/
+	uint32_t operations;	/**< Number of dispatched device operations (submitted requests and vectored operations) **/
+	uint32_t merged;		/**< Number of requests which were merged into the operation of another request **/
+} Iosched_Queue;
+
+/**
+ * @brief Initialize a request queue.
+ * @param queue Pointer to the queue structure. Must be not NULL.
+ * @param device Pointer to a registered block device. Must be not NULL.
+ * @param policy Scheduling policy.
+ */
+void iosched_initQueue(Iosched_Queue* queue, Dev_Device* device, IOSCHED_POLICY policy);
+
+/**
+ * @brief Submit a request to a queue. The request is completed like a request which was submitted with dev_submit.
+ * With IOSCHED_POLICY_ELEVATOR the request is queued until iosched_dispatch is called or the queue is full.
+ * @param queue Pointer to an initialized queue. Must be not NULL.
+ * @param request Pointer to the request with type, buf, size, offset, callback and context set. Must be not NULL.
+ * @return ERROR_INVALID_ADDRESS if buf is NULL.
+ * Otherwise ERROR_NONE, or the result of dev_submit with IOSCHED_POLICY_NOOP.
+ */
+error_t iosched_submit(Iosched_Queue* queue, Dev_Request* request);
+
+/**
+ * @brief Dispatch all queued requests. Requests are served in ascending offset order starting at the current position (C-LOOK).
+ * Adjacent requests of the same type are merged into one dev_readv or dev_writev operation (executed synchronously),
+ * single requests are passed to dev_submit. If a merged operation transfers no byte, all of its requests fail with
+ * ERROR_DEV_IO_FAILED. After a short transfer, the request it ends in fails with ERROR_OUT_OF_RANGE
+ * and the following requests are submitted on their own.
+ * @param queue Pointer to an initialized queue. Must be not NULL.
+ */
+void iosched_dispatch(Iosched_Queue* queue);
+
+#endif // IOSCHED_H
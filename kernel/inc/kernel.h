@@ -53,6 +53,12 @@ typedef unsigned error_t;
  */
 typedef uint32_t size_t;
 
+/**
+ * @brief Maximum value of size_t (the C library value may belong to another size type, for example on host builds).
+ */
+#undef SIZE_MAX
+#define SIZE_MAX UINT32_MAX
+
 /**
  * @brief General purpose error codes.
  */
@@ -86,15 +92,26 @@ error_t device_init(void);
 error_t device_initDrivers(void);
 
 /********** Memory map ***********/
+/**
+ * @brief Memory section attributes (can be combined).
+ */
+typedef enum DEVICE_MEMORY_ATTR
+{
+	DEVICE_MEMORY_ATTR_NONE	= 0,		/**< No special attributes */
+	DEVICE_MEMORY_ATTR_FAST	= (1<<0),	/**< Memory is tightly coupled to the core (for example CCM) */
+	DEVICE_MEMORY_ATTR_DMA	= (1<<1)	/**< Memory is accessible by DMA controllers */
+} DEVICE_MEMORY_ATTR;
+
 /**
  * @brief Discribes a memory section (RAM).
  */
 typedef struct Device_MemorySection
 {
-	void* start;		/**< Start address of memory section */
-	void* end;			/**< End address of memory section (start+size) */
-	size_t size;		/**< Size of memory address */
-	bool isInternal;	/**< Is memory internal (true) or external (false) */
+	void* start;			/**< Start address of memory section */
+	void* end;				/**< End address of memory section (start+size) */
+	size_t size;			/**< Size of memory address */
+	bool isInternal;		/**< Is memory internal (true) or external (false) */
+	uint32_t attributes;	/**< Memory attributes (see DEVICE_MEMORY_ATTR) */
 } Device_MemorySection;
 
 /**
@@ -108,6 +125,21 @@ extern const Device_MemorySection device_memoryMap[];
 extern const size_t device_memoryMapEntryCount;
 
 /********** Constants from linker script **********/
+/**
+ * @brief Address of the end of the interrupt vector table in ROM (including the extended vector table).
+ */
+extern const size_t _ivectorEnd;
+
+/**
+ * @brief Address of the interrupt vector table in RAM.
+ */
+extern const size_t _ivectorRamStart;
+
+/**
+ * @brief Address of the end of the interrupt vector table in RAM.
+ */
+extern const size_t _ivectorRamEnd;
+
 /**
  * @brief Address of .text section start.
  */
@@ -0,0 +1,84 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file memdev.h
+ *
+ * @brief Memory device module. Provides the built-in devices 'ram' (block RAM disk on a configurable memory region),
+ * 'null' (sink, discards writes and reads nothing) and 'zero' (source, reads zeros). They need no hardware and are used
+ * as reference devices for the device layer (for example see devbench.h).
+ */
+
+#ifndef MEMDEV_H
+#define MEMDEV_H
+
+#include <dev.h>
+
+/**
+ * @brief Block size of RAM disks in bytes (used as device type hint, read and write accept any size and offset).
+ */
+#ifndef MEMDEV_RAM_BLOCK_SIZE
+#define MEMDEV_RAM_BLOCK_SIZE 512
+#endif
+
+/**
+ * @brief RAM disk. The memory is provided by the caller and must stay valid until the RAM disk is unregistered.
+ */
+typedef struct Memdev_Ram
+{
+	Dev_Device device;	/**< Registered device named 'ram' (must be the first member) **/
+	uint8_t* mem;		/**< Backing memory region **/
+	size_t size;		/**< Size of the backing memory region in bytes **/
+} Memdev_Ram;
+
+/**
+ * @brief Register the devices 'null0' and 'zero0'. Must be called after dev_init.
+ * @return Error code of dev_registerDevice.
+ */
+error_t memdev_init(void);
+
+/**
+ * @brief Unregister the devices 'null0' and 'zero0'.
+ */
+void memdev_deinit(void);
+
+/**
+ * @brief Register a RAM disk named 'ram<number>' on a memory region. The content of the region is kept
+ * (a RAM disk can be registered again on the same region).
+ * @param ram Pointer to the RAM disk structure. Must be not NULL.
+ * @param number Device number.
+ * @param mem Backing memory region. Must be not NULL.
+ * @param size Size of the backing memory region in bytes.
+ * @return ERROR_INVALID_ADDRESS if mem is NULL.
+ * Otherwise error code of dev_registerDevice.
+ */
+error_t memdev_registerRam(Memdev_Ram* ram, uint32_t number, void* mem, size_t size);
+
+/**
+ * @brief Unregister a RAM disk.
+ * @param ram Pointer to a registered RAM disk. Must be not NULL.
+ * @return Error code of dev_unregisterDevice.
+ */
+error_t memdev_unregisterRam(Memdev_Ram* ram);
+
+#endif // MEMDEV_H
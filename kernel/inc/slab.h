@@ -0,0 +1,105 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file slab.h
+ *
+ * @brief Slab module. Provides object caches for fixed-size kernel objects which are frequently allocated and freed.
+ * Objects are carved out of slab chunks (SLAB_CHUNK_SIZE bytes) which are allocated from heap.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <kernel.h>
+
+/**
+ * @brief Maximum size of a slab chunk which is allocated from heap (chunks are trimmed to a multiple of the object size,
+ * objects which are greater get a chunk of their own).
+ */
+#define SLAB_CHUNK_SIZE 512
+
+/**
+ * @brief Object cache. The structure is managed by the slab module, callers only provide its memory.
+ */
+typedef struct Slab_Cache
+{
+	const char* name;			/**< Name of the cache (for debug output) **/
+	size_t objectSize;			/**< Size of a object (aligned) **/
+	size_t objectsPerSlab;		/**< Number of objects in one slab chunk **/
+	void* slabs;				/**< Linked list of slab chunks **/
+	void* freeObjects;			/**< Linked list of free objects **/
+	size_t objectsInUse;		/**< Number of allocated objects **/
+	size_t slabCount;			/**< Number of slab chunks **/
+} Slab_Cache;
+
+/**
+ * @brief Statistics of an object cache.
+ */
+typedef struct Slab_Stats
+{
+	size_t objectSize;		/**< Size of a object (aligned) **/
+	size_t objectsInUse;	/**< Number of allocated objects **/
+	size_t objectsFree;		/**< Number of free objects in slab chunks **/
+	size_t slabCount;		/**< Number of slab chunks **/
+	size_t slabSize;		/**< Size of a slab chunk **/
+	size_t wasteSize;		/**< Memory of all slab chunks which can't hold objects (chunk headers) **/
+} Slab_Stats;
+
+/**
+ * @brief Initialize an object cache. No memory is allocated until the first object is requested.
+ * @param cache Pointer to the cache structure. Must be not NULL.
+ * @param name Name of the cache.
+ * @param objectSize Size of the objects. Will be aligned to 4 and is at least the size of a pointer.
+ */
+void slab_initCache(Slab_Cache* cache, const char* name, size_t objectSize);
+
+/**
+ * @brief Free all slab chunks of an object cache. All objects of the cache become invalid.
+ * @param cache Pointer to an initialized cache. Must be not NULL.
+ */
+void slab_deinitCache(Slab_Cache* cache);
+
+/**
+ * @brief Allocate an object from cache.
+ * @param cache Pointer to an initialized cache. Must be not NULL.
+ * @return Address of the object.
+ * Otherwise NULL if a new slab chunk is required and heap allocation failed.
+ */
+void* slab_alloc(Slab_Cache* cache);
+
+/**
+ * @brief Return an object to its cache.
+ * @param cache Pointer to the cache which the object was allocated from. Must be not NULL.
+ * @param object Address of the object. slab_free will do nothing if object is NULL.
+ */
+void slab_free(Slab_Cache* cache, void* object);
+
+/**
+ * @brief Returns stats of an object cache.
+ * @param cache Pointer to an initialized cache. Must be not NULL.
+ * @param outStats Returns the stats. Must be not NULL.
+ */
+void slab_getStats(const Slab_Cache* cache, Slab_Stats* outStats);
+
+#endif // SLAB_H
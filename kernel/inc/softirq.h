@@ -0,0 +1,75 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file softirq.h
+ *
+ * @brief Software interrupt (softirq) module. Splits interrupt handlers into a short top half and deferred work:
+ * handlers queue work items, the items are executed by the PendSV exception with the lowest interrupt priority,
+ * so they are preempted by every hardware interrupt. Queued items are executed in priority order, items of the same priority in posting order.
+ */
+
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include <kernel.h>
+#include <interrupt.h>
+#include <atomic.h>
+
+#define ERROR_SOFTIRQ_PENDSV_IN_USE (ERROR_MODULE_DEFINED)
+
+/**
+ * @brief Priorities of softirq items, the reserved software interrupt priorities (see interrupt.h).
+ */
+typedef enum SOFTIRQ_PRIORITY
+{
+	SOFTIRQ_PRIORITY_HIGH		= INT_SOFTWARE_HIGH_PRIORITY,		/**< Executed first **/
+	SOFTIRQ_PRIORITY_AVERAGE	= INT_SOFTWARE_AVERAGE_PRIORITY,	/**< Executed if there is no queued high priority item **/
+	SOFTIRQ_PRIORITY_LOW		= INT_SOFTWARE_LOW_PRIORITY			/**< Executed if there is no queued item of higher priority **/
+} SOFTIRQ_PRIORITY;
+
+/**
+ * @brief Softirq item. The memory is provided by the caller and must stay valid until the item was executed.
+ */
+typedef struct Softirq_Item
+{
+	Atomic_Node node;							/**< Queue link (managed by softirq module, must be the first member) **/
+	void (*func)(struct Softirq_Item* item);	/**< Function which is executed in the PendSV exception, gets the item (embed the item in a structure to pass data) **/
+} Softirq_Item;
+
+/**
+ * @brief Initialize the softirq module. Installs the PendSV handler with the lowest priority. Must be called after int_init.
+ * @return ERROR_SOFTIRQ_PENDSV_IN_USE if another PendSV handler is installed.
+ * Otherwise ERROR_NONE.
+ */
+error_t softirq_init(void);
+
+/**
+ * @brief Queue a softirq item and pend the PendSV exception. Lock-free, can be called from interrupt handlers of any priority
+ * and from thread mode.
+ * @param item Pointer to the item with func set. Must be not NULL and must not be queued already (it can be posted again by its function).
+ * @param priority Priority of the item (see SOFTIRQ_PRIORITY).
+ */
+void softirq_post(Softirq_Item* item, SOFTIRQ_PRIORITY priority);
+
+#endif // SOFTIRQ_H
@@ -0,0 +1,62 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * @file workq.h
+ *
+ * @brief Work queue module. Defers work out of time critical paths (for example registration calls or interrupt handlers),
+ * queued work items are executed in thread mode by the kernel main loop in posting order.
+ */
+
+#ifndef WORKQ_H
+#define WORKQ_H
+
+#include <kernel.h>
+
+/**
+ * @brief Work item. The memory is provided by the caller and must stay valid until the item was executed.
+ */
+typedef struct Workq_Item
+{
+	void (*func)(struct Workq_Item* item);	/**< Function which is executed, gets the item (embed the item in a structure to pass data) **/
+	struct Workq_Item* next;				/**< Next queued item (managed by work queue module) **/
+} Workq_Item;
+
+/**
+ * @brief Initialize the work queue.
+ */
+void workq_init(void);
+
+/**
+ * @brief Queue a work item. Can be called from interrupt handlers (with a priority not above INT_KERNEL_CEILING_PRIORITY).
+ * @param item Pointer to the item with func set. Must be not NULL and must not be queued already.
+ */
+void workq_post(Workq_Item* item);
+
+/**
+ * @brief Execute all queued work items (including items which are posted meanwhile). Must be called in thread mode.
+ * @return True if at least one item was executed.
+ */
+bool workq_run(void);
+
+#endif // WORKQ_H
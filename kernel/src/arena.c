@@ -0,0 +1,153 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel arena module.
+ *
+ * An arena owns a list of chunks which are allocated from heap, the newest chunk is the head of the list.
+ * Allocations bump the position in the current chunk, a new chunk is allocated when the current one is full.
+ * Allocations greater than the chunk size get a dedicated chunk, the current chunk stays in use.
+ * A marker stores the newest chunk and the position, resetting frees all chunks in front of the marker chunk.
+ */
+
+#include <arena.h>
+#include <heap.h>
+
+typedef struct ArenaChunk
+{
+	struct ArenaChunk* next;	//next older chunk
+	uint8_t* end;				//end of the chunk
+} ArenaChunk;
+
+/* Allocate a new chunk with size bytes and insert it as the newest chunk, returns NULL if heap allocation failed */
+static ArenaChunk* addChunk(Arena* arena, size_t size)
+{
+	//size including the chunk header must not overflow
+	if (size > SIZE_MAX - sizeof(ArenaChunk))
+		return NULL;
+
+	ArenaChunk* chunk = heap_allocAttr(sizeof(ArenaChunk) + size, arena->attributes);
+	if (chunk == NULL)
+		return NULL;
+
+	chunk->next = arena->chunks;
+	chunk->end = (uint8_t*)(chunk + 1) + size;
+
+	arena->chunks = chunk;
+	arena->chunkCount++;
+
+	return chunk;
+}
+
+void arena_init(Arena* arena, const char* name, size_t chunkSize, uint32_t attributes)
+{
+	if (chunkSize == 0)
+		chunkSize = ARENA_CHUNK_SIZE;
+
+	arena->name = name;
+	arena->chunkSize = (chunkSize + 3) & ~3U;
+	arena->attributes = attributes;
+	arena->chunks = NULL;
+	arena->pos = NULL;
+	arena->end = NULL;
+	arena->allocMem = 0;
+	arena->chunkCount = 0;
+}
+
+void* arena_alloc(Arena* arena, size_t size)
+{
+	if (size == 0 || size > SIZE_MAX - 3)
+		return NULL;
+
+	//make size multiple of 4 (garanties that all allocations are aligned with 4)
+	size = (size + 3) & ~3U;
+
+	if ((size_t)(arena->end - arena->pos) < size)
+	{
+		//oversized allocations get a dedicated chunk, so the rest of the current chunk stays usable
+		if (size > arena->chunkSize)
+		{
+			ArenaChunk* chunk = addChunk(arena, size);
+			if (chunk == NULL)
+				return NULL;
+
+			arena->allocMem += size;
+			return chunk + 1;
+		}
+
+		//the rest of the current chunk is lost until the arena is reset
+		ArenaChunk* chunk = addChunk(arena, arena->chunkSize);
+		if (chunk == NULL)
+			return NULL;
+
+		arena->pos = (uint8_t*)(chunk + 1);
+		arena->end = chunk->end;
+	}
+
+	void* mem = arena->pos;
+	arena->pos += size;
+	arena->allocMem += size;
+
+	return mem;
+}
+
+void arena_getMarker(const Arena* arena, Arena_Marker* outMarker)
+{
+	outMarker->chunk = arena->chunks;
+	outMarker->pos = arena->pos;
+	outMarker->end = arena->end;
+	outMarker->allocMem = arena->allocMem;
+}
+
+void arena_reset(Arena* arena, const Arena_Marker* marker)
+{
+	//free all chunks which were allocated after the marker
+	ArenaChunk* chunk = arena->chunks;
+	while (chunk != NULL && chunk != marker->chunk)
+	{
+		ArenaChunk* next = chunk->next;
+		heap_free(chunk);
+		arena->chunkCount--;
+		chunk = next;
+	}
+
+	arena->chunks = chunk;
+	arena->pos = marker->pos;
+	arena->end = marker->end;
+	arena->allocMem = marker->allocMem;
+}
+
+void arena_release(Arena* arena)
+{
+	const Arena_Marker empty = { NULL, NULL, NULL, 0 };
+	arena_reset(arena, &empty);
+}
+
+void arena_getStats(const Arena* arena, Arena_Stats* outStats)
+{
+	outStats->allocMem = arena->allocMem;
+	outStats->chunkCount = arena->chunkCount;
+	outStats->chunkMem = 0;
+
+	for (const ArenaChunk* chunk = arena->chunks; chunk != NULL; chunk = chunk->next)
+		outStats->chunkMem += (size_t)(chunk->end - (const uint8_t*)(chunk + 1));
+}
@@ -0,0 +1,75 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel atomic module.
+ *
+ * On a single core other code can only run between LDREX and STREX by an exception, which clears the exclusive monitor.
+ * So the STREX fails and the sequence is retried if it was interrupted, there is no ABA problem.
+ */
+
+#include <atomic.h>
+#include <device.h>
+
+void atomic_push(Atomic_Node* volatile* head, Atomic_Node* node)
+{
+	do
+	{
+		node->next = (Atomic_Node*)__LDREXW((volatile uint32_t*)head);
+	} while (__STREXW((uint32_t)node, (volatile uint32_t*)head) != 0);
+}
+
+Atomic_Node* atomic_pop(Atomic_Node* volatile* head)
+{
+	Atomic_Node* node;
+	do
+	{
+		node = (Atomic_Node*)__LDREXW((volatile uint32_t*)head);
+		if (node == NULL)
+		{
+			__CLREX();
+			return NULL;
+		}
+	} while (__STREXW((uint32_t)node->next, (volatile uint32_t*)head) != 0);
+
+	return node;
+}
+
+Atomic_Node* atomic_takeAll(Atomic_Node* volatile* head)
+{
+	Atomic_Node* node;
+	do
+	{
+		node = (Atomic_Node*)__LDREXW((volatile uint32_t*)head);
+	} while (__STREXW(0, (volatile uint32_t*)head) != 0);
+
+	return node;
+}
+
+void atomic_add(volatile uint32_t* value, int32_t add)
+{
+	uint32_t tmp;
+	do
+	{
+		tmp = __LDREXW(value);
+	} while (__STREXW(tmp + add, value) != 0);
+}
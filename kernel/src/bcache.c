@@ -0,0 +1,637 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel buffer cache module.
+ *
+ * All buffers are allocated at initialization. A buffer is found by (device, block) in a hash table,
+ * unreferenced buffers are kept in a LRU list (least recently used first) and reused from its head.
+ * Dirty buffers are written back when they are reused or synced (write-back cache).
+ *
+ * Prefetched buffers are referenced until their request is completed. The completion only changes the
+ * request status (interrupt context), completed prefetches are collected by the next cache access.
+ */
+
+#include <bcache.h>
+#include <heap.h>
+#include <util.h>
+#include <device.h>
+
+static const char moduleName[] = "bcache";
+
+static size_t blockSize;			//size of a block
+static size_t bufferCount;			//number of buffers
+static Bcache_Buffer* buffers;		//buffer array (NULL if not initialized)
+static uint8_t* bufferData;			//data of all buffers
+static Bcache_Buffer** hashTable;	//hash table of valid buffers (chained by nextHash)
+static size_t hashMask;				//hash table size - 1 (size is a power of 2)
+static Bcache_Buffer* lruHead;		//least recently used unreferenced buffer
+static Bcache_Buffer* lruTail;		//most recently used unreferenced buffer
+static Bcache_Buffer* prefetches;	//buffers with pending or not collected prefetch requests
+
+static uint32_t hits;
+static uint32_t misses;
+static uint32_t evictions;
+static uint32_t writeBacks;
+static uint32_t prefetchCount;
+static uint32_t prefetchWaits;
+
+/********** list operations **********/
+
+static inline Bcache_Buffer** hashBucket(const Dev_Device* device, uint32_t block)
+{
+	return &hashTable[(((uintptr_t)device >> 2) ^ (block * 2654435761U)) & hashMask];
+}
+
+static void hashInsert(Bcache_Buffer* buffer)
+{
+	Bcache_Buffer** bucket = hashBucket(buffer->device, buffer->block);
+	buffer->nextHash = *bucket;
+	*bucket = buffer;
+}
+
+static void hashRemove(Bcache_Buffer* buffer)
+{
+	Bcache_Buffer** link = hashBucket(buffer->device, buffer->block);
+	while (*link != buffer)
+		link = &(*link)->nextHash;
+
+	*link = buffer->nextHash;
+}
+
+static Bcache_Buffer* hashFind(const Dev_Device* device, uint32_t block)
+{
+	for (Bcache_Buffer* buffer = *hashBucket(device, block); buffer != NULL; buffer = buffer->nextHash)
+	{
+		if (buffer->device == device && buffer->block == block)
+			return buffer;
+	}
+
+	return NULL;
+}
+
+static void lruRemove(Bcache_Buffer* buffer)
+{
+	if (buffer->prevLru != NULL)
+		buffer->prevLru->nextLru = buffer->nextLru;
+	else
+		lruHead = buffer->nextLru;
+
+	if (buffer->nextLru != NULL)
+		buffer->nextLru->prevLru = buffer->prevLru;
+	else
+		lruTail = buffer->prevLru;
+}
+
+/* Insert buffer as most recently used */
+static void lruAppend(Bcache_Buffer* buffer)
+{
+	buffer->prevLru = lruTail;
+	buffer->nextLru = NULL;
+	if (lruTail != NULL)
+		lruTail->nextLru = buffer;
+	else
+		lruHead = buffer;
+
+	lruTail = buffer;
+}
+
+/* Insert buffer as least recently used (reused first) */
+static void lruPrepend(Bcache_Buffer* buffer)
+{
+	buffer->prevLru = NULL;
+	buffer->nextLru = lruHead;
+	if (lruHead != NULL)
+		lruHead->prevLru = buffer;
+	else
+		lruTail = buffer;
+
+	lruHead = buffer;
+}
+
+/********** buffer operations **********/
+
+/* Write buffer to its device if it is dirty */
+static error_t writeBack(Bcache_Buffer* buffer)
+{
+	if (!buffer->dirty)
+		return ERROR_NONE;
+
+	if (dev_write(buffer->device, buffer->data, blockSize, buffer->block * blockSize) != blockSize)
+		return ERROR_BCACHE_IO_FAILED;
+
+	buffer->dirty = false;
+	writeBacks++;
+	return ERROR_NONE;
+}
+
+/* Remove an unreferenced buffer from the cache, it is reused first */
+static void dropBuffer(Bcache_Buffer* buffer)
+{
+	hashRemove(buffer);
+	buffer->device = NULL;
+	buffer->dirty = false;
+
+	lruRemove(buffer);
+	lruPrepend(buffer);
+}
+
+/* Take the least recently used buffer for a block (writes it back if it is dirty), returns NULL if no buffer is aviable.
+ * Buffers which can't be written back stay cached (dirty), the next buffer in LRU order is taken instead */
+static Bcache_Buffer* takeBuffer(Dev_Device* device, uint32_t block)
+{
+	Bcache_Buffer* buffer = lruHead;
+	while (buffer != NULL && writeBack(buffer) != ERROR_NONE)
+		buffer = buffer->nextLru;
+
+	if (buffer == NULL)
+		return NULL;
+
+	if (buffer->device != NULL)
+	{
+		hashRemove(buffer);
+		evictions++;
+	}
+
+	lruRemove(buffer);
+	buffer->device = device;
+	buffer->block = block;
+	buffer->dirty = false;
+	buffer->prefetched = false;
+
+	return buffer;
+}
+
+/* Release buffers of completed prefetches, failed prefetches are dropped */
+static void collectPrefetches(void)
+{
+	Bcache_Buffer** link = &prefetches;
+	while (*link != NULL)
+	{
+		Bcache_Buffer* buffer = *link;
+		if (buffer->request.status == DEV_REQUEST_STATUS_PENDING)
+		{
+			link = &buffer->nextPrefetch;
+			continue;
+		}
+
+		*link = buffer->nextPrefetch;
+		buffer->prefetching = false;
+		buffer->refCount--;
+
+		if (buffer->request.error != ERROR_NONE || buffer->request.transferred != blockSize)
+		{
+			hashRemove(buffer);
+			buffer->device = NULL;
+			lruPrepend(buffer);
+		}
+		else
+		{
+			lruAppend(buffer);
+		}
+	}
+}
+
+/* Start an asynchronous read of a block if it isn't cached, returns false if no buffer is aviable,
+ * outStarted returns if a read was submitted (false if the block is cached already) */
+static bool prefetchBlock(Dev_Device* device, uint32_t block, bool* outStarted)
+{
+	*outStarted = false;
+	if (hashFind(device, block) != NULL)
+		return true;
+
+	Bcache_Buffer* buffer = takeBuffer(device, block);
+	if (buffer == NULL)
+		return false;
+
+	//the prefetch holds a reference until it is collected
+	hashInsert(buffer);
+	buffer->refCount = 1;
+	buffer->prefetching = true;
+	buffer->prefetched = true;
+	buffer->nextPrefetch = prefetches;
+	prefetches = buffer;
+	prefetchCount++;
+	*outStarted = true;
+
+	Dev_Request* request = &buffer->request;
+	request->type = DEV_REQUEST_TYPE_READ;
+	request->buf = buffer->data;
+	request->size = blockSize;
+	request->offset = block * blockSize;
+	request->callback = NULL;
+	request->context = buffer;
+	if (dev_submit(device, request) != ERROR_NONE)
+	{
+		request->status = DEV_REQUEST_STATUS_DONE;
+		request->error = ERROR_BCACHE_IO_FAILED;
+	}
+
+	return true;
+}
+
+/* Get a referenced buffer of a block, the block is only read from device if read is true (otherwise it is overwritten completely),
+ * outPrefetched (may be NULL) returns if the block was prefetched and not used before */
+static Bcache_Buffer* getBuffer(Dev_Device* device, uint32_t block, bool read, bool* outPrefetched)
+{
+	if (buffers == NULL || device->type != DEV_DEVICE_TYPE_BLOCK)
+		return NULL;
+
+	collectPrefetches();
+
+	Bcache_Buffer* buffer = hashFind(device, block);
+	if (buffer != NULL && buffer->prefetching)
+	{
+		//wait for prefetch, dev_completeRequest sets the event register so a completion before WFE isn't missed
+		prefetchWaits++;
+		while (buffer->request.status == DEV_REQUEST_STATUS_PENDING)
+			__WFE();
+
+		//failed prefetches are dropped
+		collectPrefetches();
+		buffer = hashFind(device, block);
+	}
+
+	if (outPrefetched != NULL)
+		*outPrefetched = (buffer != NULL && buffer->prefetched);
+
+	if (buffer != NULL)
+	{
+		hits++;
+		buffer->prefetched = false;
+		if (buffer->refCount++ == 0)
+			lruRemove(buffer);
+
+		return buffer;
+	}
+
+	//reuse least recently used buffer
+	misses++;
+	buffer = takeBuffer(device, block);
+	if (buffer == NULL)
+		return NULL;
+
+	if (read && dev_read(device, buffer->data, blockSize, block * blockSize) != blockSize)
+	{
+		buffer->device = NULL;
+		lruPrepend(buffer);
+		return NULL;
+	}
+
+	hashInsert(buffer);
+	buffer->refCount = 1;
+	return buffer;
+}
+
+/* Drop buffers of unregistered devices */
+static void deviceEventHandler(Dev_Device* device, DEV_DEVICE_EVENT event)
+{
+	if (event != DEV_DEVICE_EVENT_UNREGISTERED || device->type != DEV_DEVICE_TYPE_BLOCK)
+		return;
+
+	//event is sent before the device is removed, so dirty buffers can be written back
+	bcache_sync(device);
+
+	//wait for pending prefetches of the device, the buffers are target of their transfers
+	for (;;)
+	{
+		collectPrefetches();
+
+		bool pending = false;
+		for (const Bcache_Buffer* buffer = prefetches; buffer != NULL; buffer = buffer->nextPrefetch)
+		{
+			if (buffer->device == device)
+				pending = true;
+		}
+
+		if (!pending)
+			break;
+		__WFE();
+	}
+
+	//no buffer may keep the device, a device registered later at the same address would get its blocks
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		Bcache_Buffer* buffer = &buffers[i];
+		if (buffer->device != device)
+			continue;
+
+		if (buffer->refCount == 0)
+		{
+			dropBuffer(buffer);
+		}
+		else
+		{
+			//referenced buffers are detached, they are reused after their release
+			hashRemove(buffer);
+			buffer->device = NULL;
+			buffer->dirty = false;
+		}
+	}
+}
+
+/********** buffer cache interface **********/
+
+error_t bcache_init(size_t newBlockSize, size_t newBufferCount)
+{
+	if (newBlockSize == 0 || newBufferCount == 0)
+		return ERROR_INVALID_ARGUMENT;
+
+	bcache_deinit();
+
+	//hash table size is the next power of 2 >= buffer count
+	size_t hashSize = 1;
+	while (hashSize < newBufferCount)
+		hashSize <<= 1;
+
+	//block data is allocated from DMA memory, so drivers can transfer blocks directly
+	uint32_t prevOwner = heap_setCurrentOwner(heap_registerOwner(moduleName));
+	buffers = heap_alloc(newBufferCount * sizeof(Bcache_Buffer));
+	hashTable = heap_alloc(hashSize * sizeof(Bcache_Buffer*));
+	bufferData = heap_allocAttr(newBufferCount * newBlockSize, HEAP_ATTR_DMA);
+	heap_setCurrentOwner(prevOwner);
+
+	if (buffers == NULL || hashTable == NULL || bufferData == NULL)
+	{
+		heap_free(buffers);
+		heap_free(hashTable);
+		heap_free(bufferData);
+		buffers = NULL;
+		return ERROR_BCACHE_OUT_OF_MEMORY;
+	}
+
+	blockSize = newBlockSize;
+	bufferCount = newBufferCount;
+	hashMask = hashSize - 1;
+	for (size_t i = 0; i < hashSize; i++)
+		hashTable[i] = NULL;
+
+	lruHead = NULL;
+	lruTail = NULL;
+	prefetches = NULL;
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		Bcache_Buffer* buffer = &buffers[i];
+		buffer->device = NULL;
+		buffer->block = 0;
+		buffer->data = bufferData + i * blockSize;
+		buffer->dirty = false;
+		buffer->refCount = 0;
+		buffer->nextHash = NULL;
+		buffer->nextPrefetch = NULL;
+		buffer->prefetching = false;
+		buffer->prefetched = false;
+		lruAppend(buffer);
+	}
+
+	hits = 0;
+	misses = 0;
+	evictions = 0;
+	writeBacks = 0;
+	prefetchCount = 0;
+	prefetchWaits = 0;
+
+	dev_registerEventHandler(deviceEventHandler);
+	return ERROR_NONE;
+}
+
+void bcache_deinit(void)
+{
+	if (buffers == NULL)
+		return;
+
+	//wait for pending prefetches, the buffers are target of their transfers
+	collectPrefetches();
+	while (prefetches != NULL)
+	{
+		__WFE();
+		collectPrefetches();
+	}
+
+	dev_unregisterEventHandler(deviceEventHandler);
+	bcache_sync(NULL);
+
+	heap_free(buffers);
+	heap_free(hashTable);
+	heap_free(bufferData);
+	buffers = NULL;
+	bufferCount = 0;
+}
+
+Bcache_Buffer* bcache_get(Dev_Device* device, uint32_t block)
+{
+	return getBuffer(device, block, true, NULL);
+}
+
+void bcache_markDirty(Bcache_Buffer* buffer)
+{
+	buffer->dirty = true;
+}
+
+void bcache_release(Bcache_Buffer* buffer)
+{
+	if (buffer == NULL)
+		return;
+
+	if (--buffer->refCount == 0)
+	{
+		//buffers which were detached from an unregistered device are reused first
+		if (buffer->device == NULL)
+		{
+			buffer->dirty = false;
+			lruPrepend(buffer);
+		}
+		else
+		{
+			lruAppend(buffer);
+		}
+	}
+}
+
+error_t bcache_sync(Dev_Device* device)
+{
+	error_t error = ERROR_NONE;
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		Bcache_Buffer* buffer = &buffers[i];
+		if (buffer->device != NULL && (device == NULL || buffer->device == device) && writeBack(buffer) != ERROR_NONE)
+			error = ERROR_BCACHE_IO_FAILED;
+	}
+
+	return error;
+}
+
+size_t bcache_read(Dev_Device* device, void* buf, size_t size, size_t offset)
+{
+	if (buffers == NULL)
+		return 0;
+
+	size_t done = 0;
+	while (done < size)
+	{
+		uint32_t block = (offset + done) / blockSize;
+		size_t blockOffset = (offset + done) % blockSize;
+		size_t count = blockSize - blockOffset;
+		if (count > size - done)
+			count = size - done;
+
+		Bcache_Buffer* buffer = getBuffer(device, block, true, NULL);
+		if (buffer == NULL)
+			break;
+
+		util_memcpy(buffer->data + blockOffset, (uint8_t*)buf + done, count);
+		bcache_release(buffer);
+		done += count;
+	}
+
+	return done;
+}
+
+size_t bcache_write(Dev_Device* device, const void* buf, size_t size, size_t offset)
+{
+	if (buffers == NULL)
+		return 0;
+
+	size_t done = 0;
+	while (done < size)
+	{
+		uint32_t block = (offset + done) / blockSize;
+		size_t blockOffset = (offset + done) % blockSize;
+		size_t count = blockSize - blockOffset;
+		if (count > size - done)
+			count = size - done;
+
+		//blocks which are overwritten completely aren't read
+		Bcache_Buffer* buffer = getBuffer(device, block, count != blockSize, NULL);
+		if (buffer == NULL)
+			break;
+
+		util_memcpy((const uint8_t*)buf + done, buffer->data + blockOffset, count);
+		buffer->dirty = true;
+		bcache_release(buffer);
+		done += count;
+	}
+
+	return done;
+}
+
+void bcache_openStream(Bcache_Stream* stream, Dev_Device* device)
+{
+	stream->device = device;
+	stream->nextOffset = 0;
+	stream->prefetchEnd = 0;
+	stream->window = 0;
+
+	stream->reads = 0;
+	stream->sequentialReads = 0;
+	stream->prefetchedBlocks = 0;
+	stream->prefetchHits = 0;
+}
+
+size_t bcache_readStream(Bcache_Stream* stream, void* buf, size_t size, size_t offset)
+{
+	if (buffers == NULL || size == 0)
+		return 0;
+
+	//sequential reads grow the read-ahead window, other reads reset it
+	stream->reads++;
+	if (offset == stream->nextOffset && stream->reads > 1)
+	{
+		size_t maxWindow = (BCACHE_READAHEAD_MAX < bufferCount / 2) ? BCACHE_READAHEAD_MAX : bufferCount / 2;
+		stream->window = (stream->window == 0) ? BCACHE_READAHEAD_MIN : stream->window * 2;
+		if (stream->window > maxWindow)
+			stream->window = maxWindow;
+
+		stream->sequentialReads++;
+	}
+	else
+	{
+		stream->window = 0;
+		stream->prefetchEnd = 0;
+	}
+
+	size_t done = 0;
+	while (done < size)
+	{
+		uint32_t block = (offset + done) / blockSize;
+		size_t blockOffset = (offset + done) % blockSize;
+		size_t count = blockSize - blockOffset;
+		if (count > size - done)
+			count = size - done;
+
+		bool prefetched;
+		Bcache_Buffer* buffer = getBuffer(stream->device, block, true, &prefetched);
+		if (buffer == NULL)
+			break;
+
+		if (prefetched)
+			stream->prefetchHits++;
+
+		util_memcpy(buffer->data + blockOffset, (uint8_t*)buf + done, count);
+		bcache_release(buffer);
+		done += count;
+	}
+
+	stream->nextOffset = offset + done;
+
+	//prefetch the window behind the read blocks (blocks which are prefetched already are skipped)
+	if (stream->window != 0)
+	{
+		uint32_t start = (stream->nextOffset + blockSize - 1) / blockSize;
+		uint32_t end = start + stream->window;
+		if (start < stream->prefetchEnd)
+			start = stream->prefetchEnd;
+
+		for (uint32_t block = start; block < end; block++)
+		{
+			bool started;
+			if (!prefetchBlock(stream->device, block, &started))
+				break;
+
+			//cached blocks are skipped, only blocks read from the device count as prefetched
+			if (started)
+				stream->prefetchedBlocks++;
+			stream->prefetchEnd = block + 1;
+		}
+	}
+
+	return done;
+}
+
+void bcache_getStats(Bcache_Stats* outStats)
+{
+	outStats->blockSize = blockSize;
+	outStats->bufferCount = bufferCount;
+	outStats->dirtyCount = 0;
+	outStats->hits = hits;
+	outStats->misses = misses;
+	outStats->evictions = evictions;
+	outStats->writeBacks = writeBacks;
+	outStats->prefetches = prefetchCount;
+	outStats->prefetchWaits = prefetchWaits;
+
+	for (size_t i = 0; i < bufferCount; i++)
+	{
+		if (buffers[i].device != NULL && buffers[i].dirty)
+			outStats->dirtyCount++;
+	}
+}
@@ -80,18 +80,19 @@ static char* itoa(int num, char* str, int base)
 
 	// In standard itoa(), negative numbers are handled only with
 	// base 10. Otherwise numbers are considered unsigned.
+	unsigned value = num;
 	if (num < 0 && base == 10)
 	{
 		isNegative = true;
-		num = -num;
+		value = -num;
 	}
 
 	// Process individual digits
-	while (num != 0)
+	while (value != 0)
 	{
-		int rem = num % base;
+		unsigned rem = value % base;
 		str[i++] = (rem > 9)? (rem-10) + 'a' : rem + '0';
-		num = num/base;
+		value = value/base;
 	}
 
 	// If number is negative, append '-'
@@ -23,57 +23,231 @@
 
 #include <dev.h>
 #include <heap.h>
+#include <slab.h>
 #include <util.h>
-
-typedef struct Dev_DeviceEntry
-{
-	struct Dev_DeviceEntry* next;
-	Dev_Device* device;
-} Dev_DeviceEntry;
+#include <workq.h>
+#include <device.h>
 
 typedef struct Dev_EventHandlerEntry
 {
 	struct Dev_EventHandlerEntry* next;
 	Dev_EventHandler handler;
+	bool deferred;	//handler is called by the work queue
 } Dev_EventHandlerEntry;
 
+typedef struct Dev_EventEntry
+{
+	Workq_Item work;	//must be first member (work item is casted to entry)
+	Dev_Device* device;
+	DEV_DEVICE_EVENT event;
+} Dev_EventEntry;
+
 const char* moduleName = "dev";
-Dev_DeviceEntry* deviceEntries = NULL;
+Dev_Device* deviceTable[DEV_HASH_TABLE_SIZE];	//hash table of registered devices (chained by Dev_Device::nextHash)
 Dev_EventHandlerEntry* eventHandlers = NULL;
 
-/* Subroutine to check if a given device name already exists in registered device list */
-static bool deviceIdExists(const Dev_Device* device)
+static Slab_Cache eventHandlerEntryCache;
+static Slab_Cache eventEntryCache;
+static size_t pendingEvents;	//number of queued events
+static uint32_t heapOwner;	//heap owner ID of the module
+
+/* Hash of a device name (FNV-1a) */
+static uint32_t hashName(const char* name)
+{
+	uint32_t hash = 2166136261U;
+	while (*name != '\0')
+	{
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/* Bucket of a device name (name hash and number) in the device table */
+static inline Dev_Device** deviceBucket(uint32_t nameHash, uint32_t number)
+{
+	return &deviceTable[(nameHash ^ (number * 2654435761U)) & (DEV_HASH_TABLE_SIZE-1)];
+}
+
+/********** statistics **********/
+
+#ifdef DEVSTATS
+
+/* Record an operation (counters may lose updates if requests are completed by interrupts during a thread mode operation of the same device) */
+static void statsRecord(Dev_Device* device, DEV_STATS_OP op, uint32_t startCycle, size_t bytes, bool failed)
+{
+	uint32_t cycles = DWT->CYCCNT - startCycle;
+	Dev_OpStats* stats = &device->stats[op];
+
+	uint32_t bucket = (cycles != 0) ? 31 - __CLZ(cycles) : 0;
+	if (bucket >= DEV_STATS_HISTOGRAM_SIZE)
+		bucket = DEV_STATS_HISTOGRAM_SIZE-1;
+
+	stats->count++;
+	stats->bytes += bytes;
+	stats->histogram[bucket]++;
+	if (failed)
+		stats->errors++;
+}
+
+/* A transfer without bytes only fails on block devices, char devices may have no data (for example end of input or the null device) */
+#define STATS_SHORT(device, transferred, requested) ((transferred) == 0 && (requested) != 0 && (device)->type == DEV_DEVICE_TYPE_BLOCK)
+
+#define STATS_BEGIN() uint32_t statsStartCycle = DWT->CYCCNT
+#define STATS_END(device, op, bytes, failed) statsRecord(device, op, statsStartCycle, bytes, failed)
+
+#else
+
+#define STATS_BEGIN()
+#define STATS_END(device, op, bytes, failed)
+
+#endif
+
+/********** events **********/
+
+/* Work queue function, calls deferred event handlers */
+static void deliverEvent(Workq_Item* work)
 {
-	for (const Dev_DeviceEntry* entry = deviceEntries; entry != NULL; entry = entry->next)
+	Dev_EventEntry* entry = (Dev_EventEntry*)work;
+	for (Dev_EventHandlerEntry* eventHandler = eventHandlers; eventHandler != NULL; eventHandler = eventHandler->next)
+	{
+		if (eventHandler->deferred)
+			eventHandler->handler(entry->device, entry->event);
+	}
+
+	slab_free(&eventEntryCache, entry);
+	pendingEvents--;
+}
+
+/* Call event handlers, deferred handlers get the event through the work queue */
+static void notifyEventHandlers(Dev_Device* device, DEV_DEVICE_EVENT event)
+{
+	bool hasDeferred = false;
+	for (Dev_EventHandlerEntry* eventHandler = eventHandlers; eventHandler != NULL; eventHandler = eventHandler->next)
+	{
+		if (eventHandler->deferred)
+			hasDeferred = true;
+		else
+			eventHandler->handler(device, event);
+	}
+
+	if (!hasDeferred)
+		return;
+
+	//one queued event for all deferred handlers (the work queue keeps the order of events)
+	uint32_t prevOwner = heap_setCurrentOwner(heapOwner);
+	Dev_EventEntry* entry = slab_alloc(&eventEntryCache);
+	heap_setCurrentOwner(prevOwner);
+	if (entry != NULL)
 	{
-		//first check device number (integer comparison is faster than string)
-		if (entry->device->number == device->number)
+		entry->work.func = deliverEvent;
+		entry->device = device;
+		entry->event = event;
+		pendingEvents++;
+		workq_post(&entry->work);
+	}
+	else
+	{
+		//no memory for the event, better deliver it now than never
+		for (Dev_EventHandlerEntry* eventHandler = eventHandlers; eventHandler != NULL; eventHandler = eventHandler->next)
 		{
-			//then check device name is equal, if they are equal -> device exists already
-			if (util_strcmp(entry->device->name, device->name) == 0)
-				return true;
+			if (eventHandler->deferred)
+				eventHandler->handler(device, event);
 		}
 	}
+}
+
+/* Append an event handler */
+static error_t addEventHandler(Dev_EventHandler handler, bool deferred)
+{
+	//check parameter
+	if (handler == NULL)
+		return ERROR_INVALID_ADDRESS;
+
+	//create eventhandler node
+	uint32_t prevOwner = heap_setCurrentOwner(heapOwner);
+	Dev_EventHandlerEntry* newEventHandler = slab_alloc(&eventHandlerEntryCache);
+	heap_setCurrentOwner(prevOwner);
+	if (newEventHandler == NULL)
+		return ERROR_DEV_MEMORY_ALLOCATION_FAILED;
+
+	newEventHandler->handler = handler;
+	newEventHandler->deferred = deferred;
+	newEventHandler->next = NULL;
+
+	//append node
+	if (eventHandlers == NULL) //if no entry
+	{
+		eventHandlers = newEventHandler;
+	}
+	else //if one or more entries
+	{
+		Dev_EventHandlerEntry* eventHandler;
+		for (eventHandler = eventHandlers; eventHandler->next != NULL; eventHandler = eventHandler->next)
+			;
+
+		eventHandler->next = newEventHandler;
+	}
 
-	return false;
+	return ERROR_NONE;
+}
+
+/* Find a device by name hash, name and number */
+static Dev_Device* findDevice(uint32_t nameHash, const char* name, uint32_t number)
+{
+	for (Dev_Device* device = *deviceBucket(nameHash, number); device != NULL; device = device->nextHash)
+	{
+		//first check hash and number (integer comparison is faster than string), then check name
+		if (device->nameHash == nameHash && device->number == number && util_strcmp(device->name, name) == 0)
+			return device;
+	}
+
+	return NULL;
 }
 
 void dev_init(void)
 {
-	//null linked lists
-	deviceEntries = NULL;
+	//null device table and linked list
+	for (size_t i = 0; i < DEV_HASH_TABLE_SIZE; i++)
+		deviceTable[i] = NULL;
 	eventHandlers = NULL;
+
+#ifdef DEVSTATS
+	//enable cycle counter for latency statistics
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+	//memory of the module is accounted to its name
+	heapOwner = heap_registerOwner(moduleName);
+
+	//initialize object caches for list entries and queued events
+	slab_initCache(&eventHandlerEntryCache, "dev_eventhandler", sizeof(Dev_EventHandlerEntry));
+	slab_initCache(&eventEntryCache, "dev_event", sizeof(Dev_EventEntry));
+	pendingEvents = 0;
 }
 
 void dev_deinit(void)
 {
 	//unregister left devices
-	while (deviceEntries != NULL)
-		dev_unregisterDevice(deviceEntries->device);
+	for (size_t i = 0; i < DEV_HASH_TABLE_SIZE; i++)
+	{
+		while (deviceTable[i] != NULL)
+			dev_unregisterDevice(deviceTable[i]);
+	}
+
+	//deliver queued events
+	while (pendingEvents != 0)
+		workq_run();
 
 	//unregister left event handlers
 	while (eventHandlers != NULL)
 		dev_unregisterEventHandler(eventHandlers->handler);
+
+	//release object caches
+	slab_deinitCache(&eventHandlerEntryCache);
+	slab_deinitCache(&eventEntryCache);
 }
 
 error_t dev_registerDevice(Dev_Device* device)
@@ -83,34 +257,22 @@ error_t dev_registerDevice(Dev_Device* device)
 		return ERROR_DEV_INVALID_DEVICE_STRUCTURE;
 
 	//check if device name (name, number) exists already
-	if (deviceIdExists(device))
+	uint32_t nameHash = hashName(device->name);
+	if (findDevice(nameHash, device->name, device->number) != NULL)
 		return ERROR_DEV_DEVICE_NAME_EXISTS_ALREADY;
 
-	//create new device entry node for linked list
-	Dev_DeviceEntry* newDeviceEntry = heap_alloc(sizeof(Dev_DeviceEntry));
-	if (newDeviceEntry == NULL)
-		return ERROR_DEV_MEMORY_ALLOCATION_FAILED;
-
-	newDeviceEntry->device = device;
-	newDeviceEntry->next = NULL;
+#ifdef DEVSTATS
+	dev_resetStats(device);
+#endif
 
-	//append new node
-	if (deviceEntries == NULL) //if no entry
-	{
-		deviceEntries = newDeviceEntry;
-	}
-	else //if one or more entries
-	{
-		Dev_DeviceEntry* deviceEntry;
-		for (deviceEntry = deviceEntries; deviceEntry->next != NULL; deviceEntry = deviceEntry->next)
-			;
-
-		deviceEntry->next = newDeviceEntry;
-	}
+	//insert device at the front of its bucket
+	Dev_Device** bucket = deviceBucket(nameHash, device->number);
+	device->nameHash = nameHash;
+	device->nextHash = *bucket;
+	*bucket = device;
 
 	//call eventhandlers because of registered device event
-	for (Dev_EventHandlerEntry* eventHandler = eventHandlers; eventHandler != NULL; eventHandler = eventHandler->next)
-		eventHandler->handler(newDeviceEntry->device, DEV_DEVICE_EVENT_REGISTERED);
+	notifyEventHandlers(device, DEV_DEVICE_EVENT_REGISTERED);
 
 	return ERROR_NONE;
 }
@@ -121,77 +283,208 @@ error_t dev_unregisterDevice(Dev_Device* device)
 	if (device->name == NULL || (device->type != DEV_DEVICE_TYPE_BLOCK && device->type != DEV_DEVICE_TYPE_CHAR))
 		return ERROR_DEV_INVALID_DEVICE_STRUCTURE;
 
-	//if no entry
-	if (deviceEntries == NULL)
+	//find device in its bucket (nameHash is only valid if device is registered, otherwise the device isn't found)
+	Dev_Device** link = deviceBucket(device->nameHash, device->number);
+	while (*link != NULL && *link != device)
+		link = &(*link)->nextHash;
+
+	if (*link == NULL)
 		return ERROR_DEV_DEVICE_NOT_REGISTERED;
 
-	//find entry
-	Dev_DeviceEntry* prevEntry = NULL;
-	Dev_DeviceEntry* curEntry = deviceEntries;
-	while (curEntry != NULL)
-	{
-		if (curEntry->device == device) //entry found
-			break;
+	//call eventhandlers because of unregistered device event
+	notifyEventHandlers(device, DEV_DEVICE_EVENT_UNREGISTERED);
 
-		if (curEntry->next == NULL) //end of list -> not found
-			return ERROR_DEV_DEVICE_NOT_REGISTERED;
+	//remove device from bucket
+	*link = device->nextHash;
+	device->nextHash = NULL;
 
-		//go to next node
-		prevEntry = curEntry;
-		curEntry = curEntry->next;
-	}
+	return ERROR_NONE;
+}
 
-	//call eventhandlers because of unregistered device event
-	for (Dev_EventHandlerEntry* eventHandler = eventHandlers; eventHandler != NULL; eventHandler = eventHandler->next)
-		eventHandler->handler(curEntry->device, DEV_DEVICE_EVENT_UNREGISTERED);
+Dev_Device* dev_find(const char* name, uint32_t number)
+{
+	return findDevice(hashName(name), name, number);
+}
 
-	//remove entry
-	Dev_DeviceEntry* tmpEntry;
-	if (prevEntry == NULL) //case: node is at the beginning of list
+error_t dev_submit(Dev_Device* device, Dev_Request* request)
+{
+	//check parameter
+	if (request->buf == NULL)
+		return ERROR_INVALID_ADDRESS;
+
+	request->device = device;
+	request->status = DEV_REQUEST_STATUS_PENDING;
+	request->transferred = 0;
+	request->error = ERROR_NONE;
+
+#ifdef DEVSTATS
+	request->submitCycle = DWT->CYCCNT;
+	request->timed = true;
+#endif
+
+	if (device->submit != NULL)
+		return device->submit(device, request);
+
+	//no asynchronous support, execute request with the synchronous operations
+	if (request->type == DEV_REQUEST_TYPE_READ && device->read != NULL)
+		dev_completeRequest(request, device->read(device, request->buf, request->size, request->offset), ERROR_NONE);
+	else if (request->type == DEV_REQUEST_TYPE_WRITE && device->write != NULL)
+		dev_completeRequest(request, device->write(device, request->buf, request->size, request->offset), ERROR_NONE);
+	else
+		return ERROR_DEV_OPERATION_NOT_SUPPORTED;
+
+	return ERROR_NONE;
+}
+
+void dev_completeRequest(Dev_Request* request, size_t transferred, error_t error)
+{
+	request->transferred = transferred;
+	request->error = error;
+	request->status = DEV_REQUEST_STATUS_DONE;
+
+#ifdef DEVSTATS
+	if (request->timed)
 	{
-		tmpEntry = curEntry;
-		deviceEntries = curEntry->next;
-		heap_free(tmpEntry);
+		request->timed = false;
+		statsRecord(request->device, (request->type == DEV_REQUEST_TYPE_READ) ? DEV_STATS_OP_READ : DEV_STATS_OP_WRITE,
+					request->submitCycle, transferred, error != ERROR_NONE);
 	}
-	else //case: node is at the middle or end of list
+#endif
+
+	//wake up waiting synchronous calls (see waitRequest)
+	__SEV();
+
+	if (request->callback != NULL)
+		request->callback(request);
+}
+
+/* Submit a request and wait for its completion, returns the number of transferred bytes */
+static size_t waitRequest(Dev_Device* device, DEV_REQUEST_TYPE type, void* buf, size_t size, size_t offset)
+{
+	Dev_Request request;
+	request.type = type;
+	request.buf = buf;
+	request.size = size;
+	request.offset = offset;
+	request.callback = NULL;
+	request.context = NULL;
+
+	if (dev_submit(device, &request) != ERROR_NONE)
+		return 0;
+
+	//sleep until an event occurs, dev_completeRequest sets the event register so a completion before WFE isn't missed
+	while (request.status == DEV_REQUEST_STATUS_PENDING)
+		__WFE();
+
+	return (request.error == ERROR_NONE) ? request.transferred : 0;
+}
+
+size_t dev_read(Dev_Device* device, void* buf, size_t size, size_t offset)
+{
+	if (device->read != NULL)
 	{
-		tmpEntry = curEntry;
-		prevEntry->next = curEntry->next;
-		heap_free(tmpEntry);
+		STATS_BEGIN();
+		size_t read = device->read(device, buf, size, offset);
+		STATS_END(device, DEV_STATS_OP_READ, read, STATS_SHORT(device, read, size));
+		return read;
 	}
 
-	return ERROR_NONE;
+	return waitRequest(device, DEV_REQUEST_TYPE_READ, buf, size, offset);
 }
 
-error_t dev_registerEventHandler(Dev_EventHandler handler)
+size_t dev_write(Dev_Device* device, const void* buf, size_t size, size_t offset)
 {
-	//check parameter
-	if (handler == NULL)
-		return ERROR_INVALID_ADDRESS;
+	if (device->write != NULL)
+	{
+		STATS_BEGIN();
+		size_t written = device->write(device, buf, size, offset);
+		STATS_END(device, DEV_STATS_OP_WRITE, written, STATS_SHORT(device, written, size));
+		return written;
+	}
 
-	//create eventhandler node
-	Dev_EventHandlerEntry* newEventHandler = heap_alloc(sizeof(Dev_EventHandlerEntry));
-	if (newEventHandler == NULL)
-		return ERROR_DEV_MEMORY_ALLOCATION_FAILED;
+	//the buffer isn't modified by write requests
+	return waitRequest(device, DEV_REQUEST_TYPE_WRITE, (void*)buf, size, offset);
+}
 
-	newEventHandler->handler = handler;
-	newEventHandler->next = NULL;
+size_t dev_readv(Dev_Device* device, const Dev_IoVec* vec, size_t count, size_t offset)
+{
+	if (device->readv != NULL)
+	{
+		STATS_BEGIN();
+		size_t read = device->readv(device, vec, count, offset);
+		STATS_END(device, DEV_STATS_OP_READ, read, STATS_SHORT(device, read, count));
+		return read;
+	}
 
-	//append node
-	if (eventHandlers == NULL) //if no entry
+	//generic fallback: one read per buffer
+	size_t total = 0;
+	for (size_t i = 0; i < count; i++)
 	{
-		eventHandlers = newEventHandler;
+		size_t read = dev_read(device, vec[i].base, vec[i].size, offset + total);
+		total += read;
+		if (read != vec[i].size)
+			break;
 	}
-	else //if one or more entries
+
+	return total;
+}
+
+size_t dev_writev(Dev_Device* device, const Dev_IoVec* vec, size_t count, size_t offset)
+{
+	if (device->writev != NULL)
 	{
-		Dev_EventHandlerEntry* eventHandler;
-		for (eventHandler = eventHandlers; eventHandler->next != NULL; eventHandler = eventHandler->next)
-			;
+		STATS_BEGIN();
+		size_t written = device->writev(device, vec, count, offset);
+		STATS_END(device, DEV_STATS_OP_WRITE, written, STATS_SHORT(device, written, count));
+		return written;
+	}
 
-		eventHandler->next = newEventHandler;
+	//generic fallback: one write per buffer
+	size_t total = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		size_t written = dev_write(device, vec[i].base, vec[i].size, offset + total);
+		total += written;
+		if (written != vec[i].size)
+			break;
 	}
 
-	return ERROR_NONE;
+	return total;
+}
+
+error_t dev_ioctl(Dev_Device* device, uint32_t num, void* args)
+{
+	if (device->ioctl == NULL)
+		return ERROR_DEV_OPERATION_NOT_SUPPORTED;
+
+	STATS_BEGIN();
+	error_t error = device->ioctl(device, num, args);
+	STATS_END(device, DEV_STATS_OP_IOCTL, 0, error != ERROR_NONE);
+	return error;
+}
+
+error_t dev_map(Dev_Device* device, size_t offset, size_t size, void** outAddr, size_t* outSize)
+{
+	if (device->map == NULL)
+		return ERROR_DEV_OPERATION_NOT_SUPPORTED;
+
+	return device->map(device, offset, size, outAddr, outSize);
+}
+
+void dev_unmap(Dev_Device* device, void* addr, size_t size)
+{
+	if (device->unmap != NULL)
+		device->unmap(device, addr, size);
+}
+
+error_t dev_registerEventHandler(Dev_EventHandler handler)
+{
+	return addEventHandler(handler, false);
+}
+
+error_t dev_registerDeferredEventHandler(Dev_EventHandler handler)
+{
+	return addEventHandler(handler, true);
 }
 
 error_t dev_unregisterEventHandler(Dev_EventHandler handler)
@@ -222,14 +515,66 @@ error_t dev_unregisterEventHandler(Dev_EventHandler handler)
 	{
 		tmpEntry = curEntry;
 		eventHandlers = curEntry->next;
-		heap_free(tmpEntry);
+		slab_free(&eventHandlerEntryCache, tmpEntry);
 	}
 	else //case: node is at the middle or end of list
 	{
 		tmpEntry = curEntry;
 		prevEntry->next = curEntry->next;
-		heap_free(tmpEntry);
+		slab_free(&eventHandlerEntryCache, tmpEntry);
 	}
 
 	return ERROR_NONE;
 }
+
+#ifdef DEVSTATS
+
+const Dev_OpStats* dev_getStats(const Dev_Device* device, DEV_STATS_OP op)
+{
+	if (op >= DEV_STATS_OP_COUNT)
+		return NULL;
+
+	return &device->stats[op];
+}
+
+void dev_resetStats(Dev_Device* device)
+{
+	for (size_t op = 0; op < DEV_STATS_OP_COUNT; op++)
+	{
+		Dev_OpStats* stats = &device->stats[op];
+		stats->count = 0;
+		stats->errors = 0;
+		stats->bytes = 0;
+		for (size_t i = 0; i < DEV_STATS_HISTOGRAM_SIZE; i++)
+			stats->histogram[i] = 0;
+	}
+}
+
+#ifdef DEBUG
+void dev_dumpStats(void)
+{
+	static const char* opNames[] = { "read", "write", "ioctl" };
+
+	//one line per device and operation: name number op count errors bytes (high word, low word) histogram (numbers are hexadecimal)
+	for (size_t i = 0; i < DEV_HASH_TABLE_SIZE; i++)
+	{
+		for (const Dev_Device* device = deviceTable[i]; device != NULL; device = device->nextHash)
+		{
+			for (size_t op = 0; op < DEV_STATS_OP_COUNT; op++)
+			{
+				const Dev_OpStats* stats = &device->stats[op];
+				if (stats->count == 0)
+					continue;
+
+				debug_printf("devstats %s %x %s %x %x %x %x", device->name, device->number, opNames[op], stats->count, stats->errors,
+							 (uint32_t)(stats->bytes >> 32), (uint32_t)stats->bytes);
+				for (size_t bucket = 0; bucket < DEV_STATS_HISTOGRAM_SIZE; bucket++)
+					debug_printf(" %x", stats->histogram[bucket]);
+				debug_printf("\n");
+			}
+		}
+	}
+}
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel device benchmark module.
+ *
+ * Calls go through dev_read and dev_write, so the measured cycles include the device layer (and DEVSTATS if enabled).
+ * All arithmetic is 32 bit (no 64 bit division available), a run must stay below 2^32 cycles and bytes.
+ */
+
+#include <devbench.h>
+#include <memdev.h>
+#include <heap.h>
+#include <debug.h>
+#include <device.h>
+
+/**
+ * @brief Device number of the RAM disk registered by devbench_runSuite.
+ */
+#ifndef DEVBENCH_RAM_NUMBER
+#define DEVBENCH_RAM_NUMBER 0xbe
+#endif
+
+#define SUITE_TRANSFER_SIZE 512
+#define SUITE_CALLS 256
+
+static size_t nextOffset(DEVBENCH_PATTERN pattern, uint32_t* state, size_t offset, size_t size, size_t span)
+{
+	size_t blocks = span / size;
+	if (blocks <= 1)
+		return 0;
+
+	if (pattern == DEVBENCH_PATTERN_SEQUENTIAL)
+	{
+		offset += size;
+		return (offset + size > span) ? 0 : offset;
+	}
+
+	//linear congruential generator, upper bits have the longer period
+	*state = *state * 1664525U + 1013904223U;
+	return ((*state >> 8) % blocks) * size;
+}
+
+error_t devbench_run(Dev_Device* device, DEVBENCH_OP op, DEVBENCH_PATTERN pattern, void* buf, size_t size, size_t span, uint32_t calls, Devbench_Result* result)
+{
+	if (size == 0 || calls == 0)
+		return ERROR_INVALID_ARGUMENT;
+	if ((op == DEVBENCH_OP_READ && device->read == NULL) || (op == DEVBENCH_OP_WRITE && device->write == NULL))
+		return ERROR_DEV_OPERATION_NOT_SUPPORTED;
+
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	uint32_t state = 1;
+	size_t offset = 0;
+	uint32_t bytes = 0;
+
+	uint32_t startCycle = DWT->CYCCNT;
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		if (op == DEVBENCH_OP_READ)
+			bytes += dev_read(device, buf, size, offset);
+		else
+			bytes += dev_write(device, buf, size, offset);
+
+		offset = nextOffset(pattern, &state, offset, size, span);
+	}
+	uint32_t cycles = DWT->CYCCNT - startCycle;
+
+	result->calls = calls;
+	result->bytes = bytes;
+	result->cycles = cycles;
+	result->cyclesPerCall = cycles / calls;
+	result->kibPerSecond = 0;
+
+	uint32_t kib = bytes / 1024;
+	if (kib > 0)
+	{
+		uint32_t cyclesPerKib = cycles / kib;
+		result->kibPerSecond = SystemCoreClock / (cyclesPerKib > 0 ? cyclesPerKib : 1);
+	}
+
+	return ERROR_NONE;
+}
+
+#ifdef DEBUG
+static error_t runAndPrint(Dev_Device* device, DEVBENCH_OP op, DEVBENCH_PATTERN pattern, void* buf, size_t span)
+{
+	static const char* opNames[] = { "read", "write" };
+	static const char* patternNames[] = { "seq", "rand" };
+
+	Devbench_Result result;
+	error_t error = devbench_run(device, op, pattern, buf, SUITE_TRANSFER_SIZE, span, SUITE_CALLS, &result);
+	if (error != ERROR_NONE)
+		return error;
+
+	//name number op pattern calls bytes cycles cycles/call KiB/s (numbers are decimal)
+	debug_printf("devbench %s %i %s %s %i %i %i %i %i\n", device->name, device->number, opNames[op], patternNames[pattern],
+			result.calls, result.bytes, result.cycles, result.cyclesPerCall, result.kibPerSecond);
+	return ERROR_NONE;
+}
+
+error_t devbench_runSuite(void)
+{
+	//the device structure must outlive the deferred delivery of its unregistration event (see dev_registerDeferredEventHandler)
+	static Memdev_Ram ram;
+	void* mem = heap_alloc(DEVBENCH_RAM_SIZE);
+	void* buf = heap_alloc(SUITE_TRANSFER_SIZE);
+	if (mem == NULL || buf == NULL)
+	{
+		heap_free(mem);
+		heap_free(buf);
+		return ERROR_HEAP_OUT_OF_MEMORY;
+	}
+
+	error_t error = memdev_registerRam(&ram, DEVBENCH_RAM_NUMBER, mem, DEVBENCH_RAM_SIZE);
+	if (error == ERROR_NONE)
+	{
+		for (size_t op = DEVBENCH_OP_READ; op <= DEVBENCH_OP_WRITE && error == ERROR_NONE; op++)
+		{
+			for (size_t pattern = DEVBENCH_PATTERN_SEQUENTIAL; pattern <= DEVBENCH_PATTERN_RANDOM && error == ERROR_NONE; pattern++)
+				error = runAndPrint(&ram.device, op, pattern, buf, DEVBENCH_RAM_SIZE);
+		}
+		memdev_unregisterRam(&ram);
+	}
+
+	//char devices have no offsets, the pattern doesn't matter
+	Dev_Device* device = dev_find("null", 0);
+	if (error == ERROR_NONE && device != NULL)
+		error = runAndPrint(device, DEVBENCH_OP_WRITE, DEVBENCH_PATTERN_SEQUENTIAL, buf, 0);
+
+	device = dev_find("zero", 0);
+	if (error == ERROR_NONE && device != NULL)
+		error = runAndPrint(device, DEVBENCH_OP_READ, DEVBENCH_PATTERN_SEQUENTIAL, buf, 0);
+
+	heap_free(buf);
+	heap_free(mem);
+	return error;
+}
+#endif
@@ -21,89 +21,1118 @@
  * THE SOFTWARE.
  */
 
+/* Kernel heap module.
+ *
+ * The heap is managed with a two-level segregated fit (TLSF) allocator. Free blocks are kept in
+ * segregated free lists which are indexed by two bitmaps (first level = power of two size class,
+ * second level = linear subdivision of the size class). Finding a suitable free block and freeing
+ * a block (including merging with its physical neighbours) take constant time.
+ *
+ * Physical neighbours are found with boundary tags: every block starts with its size (header),
+ * every free block additionally ends with a pointer to its own header (footer). The header of the
+ * following block records if its predecessor is free, so only free blocks carry the footer and an
+ * allocated block costs a single size_t.
+ *
+ * The heap manages every RAM section of device_memoryMap as an own region with own free lists, so
+ * allocations can be restricted to regions with specific attributes (for example DMA accessible memory).
+ * The control structure of a region is stored at the start of the region itself.
+ *
+ * All statistics are running counters which are updated when a block enters or leaves a free list,
+ * so they can be read in constant time.
+ *
+ * Every allocated block belongs to an owner (module), the owner ID is stored in the unused upper bits of
+ * the header (blocks are smaller than 1 MiB), so per-owner accounting needs no memory per block.
+ *
+ * Movable allocations are referenced by handles, the first word of a movable block points back to its
+ * handle. If an allocation fails, unpinned movable blocks are moved down into preceding free blocks
+ * (compaction), so free blocks are merged at the end of the region.
+ *
+ * The free lists are only modified in thread mode. Interrupt handlers allocate from lock-free pools of
+ * preallocated blocks and their frees are queued in a lock-free deferred free list, both are processed
+ * at the next heap call in thread mode (see heap_reserveIsrPool and heap_processDeferred).
+ */
+
 #include <heap.h>
+#include <util.h>
+#include <atomic.h>
+#include <device.h>
+
+/**
+ * @brief Log2 of the number of second level lists per first level class.
+ */
+#define SL_INDEX_COUNT_LOG2 4
+
+/**
+ * @brief Number of second level lists per first level class.
+ */
+#define SL_INDEX_COUNT (1<<SL_INDEX_COUNT_LOG2)
+
+/**
+ * @brief Log2 of the block alignment (all blocks and sizes are multiple of 4).
+ */
+#define ALIGN_SIZE_LOG2 2
+
+/**
+ * @brief Block alignment.
+ */
+#define ALIGN_SIZE (1<<ALIGN_SIZE_LOG2)
+
+/**
+ * @brief Blocks smaller than SMALL_BLOCK_SIZE are all stored in the first level class 0 (linear subdivision).
+ */
+#define FL_INDEX_SHIFT (SL_INDEX_COUNT_LOG2+ALIGN_SIZE_LOG2)
+#define SMALL_BLOCK_SIZE (1<<FL_INDEX_SHIFT)
+
+/**
+ * @brief Log2 of the manageable block size limit (blocks must be smaller than 1 MiB).
+ */
+#define FL_INDEX_MAX 20
+
+/**
+ * @brief Number of first level classes.
+ */
+#define FL_INDEX_COUNT (FL_INDEX_MAX-FL_INDEX_SHIFT+1)
+
+/**
+ * @brief Flag in MemoryNode::size, set if block is free.
+ */
+#define BLOCK_FREE_BIT 0x01
+
+/**
+ * @brief Flag in MemoryNode::size, set if the physical predecessor block is free (its footer is valid).
+ */
+#define BLOCK_PREV_FREE_BIT 0x02
+
+/**
+ * @brief Mask of the flag bits in MemoryNode::size.
+ */
+#define BLOCK_FLAGS_MSK (ALIGN_SIZE-1)
+
+/**
+ * @brief Position and mask of the owner ID in MemoryNode::size (only valid if block is allocated, 0 for free blocks).
+ */
+#define BLOCK_OWNER_POS 24
+#define BLOCK_OWNER_MSK (0xFFU << BLOCK_OWNER_POS)
+
+/**
+ * @brief Position and mask of the attributes requested by the allocation in MemoryNode::size (only valid if block is allocated).
+ * A moving heap_realloc uses them, so blocks without required attributes can move to any region.
+ */
+#define BLOCK_ATTR_POS FL_INDEX_MAX
+#define BLOCK_ATTR_MSK (0xFU << BLOCK_ATTR_POS)
+
+/**
+ * @brief Mask of the block size in MemoryNode::size.
+ */
+#define BLOCK_SIZE_MSK (((1U << FL_INDEX_MAX) - 1) & ~BLOCK_FLAGS_MSK)
+
+typedef struct MemoryNode
+{
+	size_t size;					//block size (including header) and flags
+	struct MemoryNode* nextFree;	//next block in free list (only valid if block is free, overlaps with user data)
+	struct MemoryNode* prevFree;	//previous block in free list (only valid if block is free, overlaps with user data)
+} MemoryNode;
+
+/**
+ * @brief Size of the header of an allocated block (size).
+ */
+#define BLOCK_HEADER_SIZE sizeof(size_t)
+
+/**
+ * @brief Size of the footer of a free block (pointer to block header).
+ */
+#define BLOCK_FOOTER_SIZE sizeof(MemoryNode*)
+
+/**
+ * @brief Smallest block size, a free block must be able to hold the free list pointers and the footer.
+ */
+#define BLOCK_SIZE_MIN (sizeof(MemoryNode)+BLOCK_FOOTER_SIZE)
+
+/**
+ * @brief Maximum number of heap regions.
+ */
+#define REGION_COUNT_MAX 4
+
+/**
+ * @brief HEAP_ATTR_ANY allocations of at least this size prefer regions which are not HEAP_ATTR_FAST.
+ */
+#define LARGE_BLOCK_SIZE 1024
+
+typedef struct HeapRegion
+{
+	uint8_t* start;			//region start address (address of this structure)
+	uint8_t* end;			//region end address (start+size)
+	uint32_t attributes;	//memory attributes (see HEAP_ATTR)
+	size_t freeMem;			//size of all free blocks
+	size_t freeBlockCount;	//number of free blocks
+
+	uint32_t flBitmap;										//first level bitmap (bit n is set if slBitmap[n] != 0)
+	uint32_t slBitmap[FL_INDEX_COUNT];						//second level bitmaps (bit m is set if freeLists[n][m] != NULL)
+	MemoryNode* freeLists[FL_INDEX_COUNT][SL_INDEX_COUNT];	//heads of the segregated free lists
+} HeapRegion;
+
+static HeapRegion* regions[REGION_COUNT_MAX];	//heap regions (order of device_memoryMap)
+static size_t regionCount;						//number of heap regions
+static size_t heapSize;							//size of all regions
+static size_t freeMem;							//size of all free blocks in all regions
+static size_t peakAllocMem;						//highest value of allocated memory (heapSize - freeMem)
+static size_t allocFailCount;					//number of failed allocation requests
+static size_t movedMem;							//number of bytes moved by compaction
+
+/********** bit operations **********/
+
+/* Index of the most significant set bit (value must not be 0) */
+static inline uint32_t fls(uint32_t value)
+{
+	return 31 - __CLZ(value);
+}
+
+/* Index of the least significant set bit (value must not be 0) */
+static inline uint32_t ffs(uint32_t value)
+{
+	return __CLZ(__RBIT(value));
+}
+
+/********** block operations **********/
+
+static inline size_t blockSize(const MemoryNode* block)
+{
+	return block->size & BLOCK_SIZE_MSK;
+}
+
+static inline bool blockIsFree(const MemoryNode* block)
+{
+	return (block->size & BLOCK_FREE_BIT) != 0;
+}
+
+static inline bool blockIsPrevFree(const MemoryNode* block)
+{
+	return (block->size & BLOCK_PREV_FREE_BIT) != 0;
+}
+
+static inline MemoryNode* blockNextPhys(const MemoryNode* block)
+{
+	return (MemoryNode*)((uint8_t*)block + blockSize(block));
+}
+
+/* Returns the physical predecessor, only valid if block has BLOCK_PREV_FREE_BIT set (footer of predecessor) */
+static inline MemoryNode* blockPrevPhys(const MemoryNode* block)
+{
+	return *((MemoryNode**)block - 1);
+}
+
+/* Set free flag, write footer and tell the next block that its predecessor is free */
+static inline void blockMarkFree(MemoryNode* block)
+{
+	MemoryNode* next = blockNextPhys(block);
+	block->size |= BLOCK_FREE_BIT;
+	*((MemoryNode**)next - 1) = block;
+	next->size |= BLOCK_PREV_FREE_BIT;
+}
+
+/* Clear free flag and tell the next block that its predecessor is allocated */
+static inline void blockMarkUsed(MemoryNode* block)
+{
+	block->size &= ~BLOCK_FREE_BIT;
+	blockNextPhys(block)->size &= ~BLOCK_PREV_FREE_BIT;
+}
+
+static inline uint32_t blockOwner(const MemoryNode* block)
+{
+	return (block->size & BLOCK_OWNER_MSK) >> BLOCK_OWNER_POS;
+}
+
+static inline uint32_t blockAttributes(const MemoryNode* block)
+{
+	return (block->size & BLOCK_ATTR_MSK) >> BLOCK_ATTR_POS;
+}
+
+static inline void blockSetAttributes(MemoryNode* block, uint32_t attributes)
+{
+	block->size = (block->size & ~BLOCK_ATTR_MSK) | (attributes << BLOCK_ATTR_POS);
+}
+
+static inline void* blockToMem(const MemoryNode* block)
+{
+	return (uint8_t*)block + BLOCK_HEADER_SIZE;
+}
+
+static inline MemoryNode* memToBlock(const void* mem)
+{
+	return (MemoryNode*)((uint8_t*)mem - BLOCK_HEADER_SIZE);
+}
+
+/********** segregated free list operations **********/
+
+/* Calculate the free list indices of a block size */
+static void mappingInsert(size_t size, uint32_t* fl, uint32_t* sl)
+{
+	if (size < SMALL_BLOCK_SIZE)
+	{
+		//small blocks are subdivided linearly
+		*fl = 0;
+		*sl = size / (SMALL_BLOCK_SIZE / SL_INDEX_COUNT);
+	}
+	else
+	{
+		uint32_t f = fls(size);
+		*sl = (size >> (f - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+		*fl = f - (FL_INDEX_SHIFT - 1);
+	}
+}
+
+/* Calculate the free list indices of the first list whose blocks are all >= size */
+static void mappingSearch(size_t size, uint32_t* fl, uint32_t* sl)
+{
+	//round up to next list, so every block of the found list is large enough
+	if (size >= SMALL_BLOCK_SIZE)
+		size += (1 << (fls(size) - SL_INDEX_COUNT_LOG2)) - 1;
+
+	mappingInsert(size, fl, sl);
+}
+
+/* Find a free block with indices >= fl/sl, returns NULL if no suitable block exists */
+static MemoryNode* searchSuitableBlock(HeapRegion* region, uint32_t* fl, uint32_t* sl)
+{
+	if (*fl >= FL_INDEX_COUNT)
+		return NULL;
+
+	//search in the current first level class
+	uint32_t slMap = region->slBitmap[*fl] & (~0U << *sl);
+	if (slMap == 0)
+	{
+		//search in the next greater first level classes
+		uint32_t flMap = region->flBitmap & (~0U << (*fl + 1));
+		if (flMap == 0)
+			return NULL;
+
+		*fl = ffs(flMap);
+		slMap = region->slBitmap[*fl];
+	}
+
+	*sl = ffs(slMap);
+	return region->freeLists[*fl][*sl];
+}
+
+static void insertFreeBlock(HeapRegion* region, MemoryNode* block)
+{
+	uint32_t fl, sl;
+	mappingInsert(blockSize(block), &fl, &sl);
+
+	//push block at the front of the list
+	MemoryNode* current = region->freeLists[fl][sl];
+	block->nextFree = current;
+	block->prevFree = NULL;
+	if (current != NULL)
+		current->prevFree = block;
+
+	region->freeLists[fl][sl] = block;
+	region->flBitmap |= (1U << fl);
+	region->slBitmap[fl] |= (1U << sl);
+
+	//update stats
+	region->freeMem += blockSize(block);
+	region->freeBlockCount++;
+	freeMem += blockSize(block);
+}
+
+static void removeFreeBlock(HeapRegion* region, MemoryNode* block)
+{
+	uint32_t fl, sl;
+	mappingInsert(blockSize(block), &fl, &sl);
+
+	MemoryNode* next = block->nextFree;
+	MemoryNode* prev = block->prevFree;
+	if (next != NULL)
+		next->prevFree = prev;
+
+	if (prev != NULL)
+	{
+		prev->nextFree = next;
+	}
+	else //block is head of its list
+	{
+		region->freeLists[fl][sl] = next;
+
+		//clear bitmap bits if list is empty now
+		if (next == NULL)
+		{
+			region->slBitmap[fl] &= ~(1U << sl);
+			if (region->slBitmap[fl] == 0)
+				region->flBitmap &= ~(1U << fl);
+		}
+	}
+
+	//update stats
+	region->freeMem -= blockSize(block);
+	region->freeBlockCount--;
+	freeMem -= blockSize(block);
+}
+
+/********** region operations **********/
+
+/* Create a region in the memory [start, start+size) */
+static void addRegion(uint8_t* start, size_t size, uint32_t attributes)
+{
+	//align region to 4 bytes
+	uint8_t* end = (uint8_t*)((uintptr_t)(start + size) & ~(uintptr_t)BLOCK_FLAGS_MSK);
+	start = (uint8_t*)(((uintptr_t)start + BLOCK_FLAGS_MSK) & ~(uintptr_t)BLOCK_FLAGS_MSK);
+
+	//the addresses are derived from linker symbols which are declared as single const objects,
+	//hide their origin from the compiler, otherwise stores into the heap memory may be optimized away (undefined behaviour)
+	__asm__ volatile ("" : "+r" (start));
+
+	//region must be able to hold the control structure, one block and the sentinel block
+	if (regionCount >= REGION_COUNT_MAX || end <= start || (size_t)(end - start) < sizeof(HeapRegion) + BLOCK_SIZE_MIN + BLOCK_HEADER_SIZE)
+		return;
+
+	//limit block size to the largest manageable block size
+	size_t blocksSize = (end - start) - sizeof(HeapRegion);
+	if (blocksSize >= (1U << FL_INDEX_MAX))
+	{
+		blocksSize = (1U << FL_INDEX_MAX) - ALIGN_SIZE;
+		end = start + sizeof(HeapRegion) + blocksSize;
+	}
+
+	//initialize control structure
+	HeapRegion* region = (HeapRegion*)start;
+	region->start = start;
+	region->end = end;
+	region->attributes = attributes;
+	region->freeMem = 0;
+	region->freeBlockCount = 0;
+
+	region->flBitmap = 0;
+	for (uint32_t fl = 0; fl < FL_INDEX_COUNT; fl++)
+	{
+		region->slBitmap[fl] = 0;
+		for (uint32_t sl = 0; sl < SL_INDEX_COUNT; sl++)
+			region->freeLists[fl][sl] = NULL;
+	}
+
+	//the whole region is one free block, followed by a zero sized sentinel block (allocated) which stops merging at region end
+	//the first block has no predecessor, so its BLOCK_PREV_FREE_BIT is never set
+	MemoryNode* block = (MemoryNode*)(start + sizeof(HeapRegion));
+	block->size = blocksSize - BLOCK_HEADER_SIZE;
+
+	MemoryNode* sentinel = blockNextPhys(block);
+	sentinel->size = 0;
+
+	blockMarkFree(block);
+	insertFreeBlock(region, block);
+
+	regions[regionCount++] = region;
+	heapSize += end - start;
+}
+
+/* Find the region of an allocated block */
+static HeapRegion* findRegion(const void* mem)
+{
+	for (size_t i = 0; i < regionCount; i++)
+	{
+		if ((const uint8_t*)mem >= regions[i]->start && (const uint8_t*)mem < regions[i]->end)
+			return regions[i];
+	}
+
+	return NULL;
+}
+
+/* Mark a block (not in a free list) as allocated and cut it down to size, the tail becomes a free block if it is large enough */
+static void trimBlock(HeapRegion* region, MemoryNode* block, size_t size)
+{
+	//if remaining memory can hold a block, split block
+	size_t remainingSize = blockSize(block) - size;
+	if (remainingSize >= BLOCK_SIZE_MIN)
+	{
+		//predecessor of remaining block is allocated, so BLOCK_PREV_FREE_BIT is not set
+		MemoryNode* remaining = (MemoryNode*)((uint8_t*)block + size);
+		remaining->size = remainingSize;
+
+		//merge remaining block with next physical block if it is free
+		MemoryNode* next = blockNextPhys(remaining);
+		if (blockIsFree(next))
+		{
+			removeFreeBlock(region, next);
+			remaining->size += blockSize(next);
+		}
+
+		blockMarkFree(remaining);
+		insertFreeBlock(region, remaining);
+
+		block->size = size | (block->size & BLOCK_PREV_FREE_BIT);
+	}
+	else //use full block
+	{
+		blockMarkUsed(block);
+	}
+}
+
+/* Allocate a block with the given (aligned) block size from a region */
+static void* allocFromRegion(HeapRegion* region, size_t size)
+{
+	//find free block >= size
+	uint32_t fl, sl;
+	mappingSearch(size, &fl, &sl);
+	MemoryNode* block = searchSuitableBlock(region, &fl, &sl);
+	if (block == NULL)
+		return NULL;
+
+	removeFreeBlock(region, block);
+	trimBlock(region, block, size);
+
+	return blockToMem(block);
+}
+
+/* Size of the largest free block of a region (the first block of the greatest non-empty free list,
+ * all blocks of this list are within 1/SL_INDEX_COUNT of the largest block) */
+static size_t regionLargestFreeBlock(const HeapRegion* region)
+{
+	if (region->flBitmap == 0)
+		return 0;
+
+	uint32_t fl = fls(region->flBitmap);
+	uint32_t sl = fls(region->slBitmap[fl]);
+	return blockSize(region->freeLists[fl][sl]);
+}
+
+/* Convert a requested memory size to a block size, returns 0 if size is too large */
+static size_t adjustSize(size_t size)
+{
+	//prevent overflow (no block can be greater than heap size)
+	if (size > heapSize)
+		return 0;
+
+	//add block header size
+	size += BLOCK_HEADER_SIZE;
+
+	//smallest allocable memory is size of memory node
+	if (size < BLOCK_SIZE_MIN)
+		size = BLOCK_SIZE_MIN;
+
+	//make size multiple of 4 (garanties that all addresses are aligned with 4)
+	return (size + (ALIGN_SIZE-1)) & ~BLOCK_FLAGS_MSK;
+}
+
+/* Returns true if the memory range [start, end) overlaps with the kernel range [rangeStart, rangeEnd) */
+static bool overlaps(const uint8_t* start, const uint8_t* end, const void* rangeStart, const void* rangeEnd)
+{
+	return (const uint8_t*)rangeStart < end && (const uint8_t*)rangeEnd > start;
+}
+
+/********** movable allocations **********/
+
+struct Heap_Movable
+{
+	MemoryNode* block;	//block of the allocation (NULL if handle is unused)
+	uint32_t pinCount;	//number of pins, the block can't be moved while pinned
+};
+
+static struct Heap_Movable handles[HEAP_HANDLE_COUNT];	//handle table
+static size_t handleCount;								//number of used handles
+
+/* Size of the back pointer in front of the memory of a movable block */
+#define MOVABLE_HEADER_SIZE sizeof(struct Heap_Movable*)
+
+/* Returns the handle of an allocated block if it is movable and not pinned, otherwise NULL */
+static Heap_Handle movableHandle(const MemoryNode* block)
+{
+	if (blockSize(block) < BLOCK_HEADER_SIZE + MOVABLE_HEADER_SIZE)
+		return NULL;
+
+	//a block is movable if its first word points to a handle which points back to the block
+	uintptr_t handle = *(const uintptr_t*)blockToMem(block);
+	if (handle < (uintptr_t)handles || handle >= (uintptr_t)(handles + HEAP_HANDLE_COUNT))
+		return NULL;
+
+	size_t index = (handle - (uintptr_t)handles) / sizeof(struct Heap_Movable);
+	if (handle != (uintptr_t)&handles[index] || handles[index].block != block || handles[index].pinCount != 0)
+		return NULL;
+
+	return &handles[index];
+}
+
+/* Copy words to a lower address (ranges may overlap) */
+static void moveDown(uint32_t* dst, const uint32_t* src, size_t size)
+{
+	for (size_t i = 0; i < size / sizeof(uint32_t); i++)
+		dst[i] = src[i];
+}
+
+/* Move all unpinned movable blocks which follow a free block down, returns the number of moved bytes */
+static size_t compactRegion(HeapRegion* region)
+{
+	size_t moved = 0;
+	MemoryNode* block = (MemoryNode*)(region->start + sizeof(HeapRegion));
+
+	//walk physical blocks until the sentinel block
+	while (blockSize(block) != 0)
+	{
+		MemoryNode* next = blockNextPhys(block);
+		Heap_Handle handle = (blockIsFree(block) && !blockIsFree(next)) ? movableHandle(next) : NULL;
+		if (handle == NULL)
+		{
+			block = next;
+			continue;
+		}
+
+		//swap free block and movable block, the free block is merged with the following block if it is free
+		size_t freeSize = blockSize(block);
+		size_t usedSize = blockSize(next);
+		removeFreeBlock(region, block);
+
+		MemoryNode* after = blockNextPhys(next);
+		if (blockIsFree(after))
+		{
+			removeFreeBlock(region, after);
+			freeSize += blockSize(after);
+		}
+
+		//the header is moved too (owner is kept), predecessor of the former free block is always allocated
+		moveDown((uint32_t*)block, (const uint32_t*)next, usedSize);
+		block->size &= ~BLOCK_PREV_FREE_BIT;
+		handle->block = block;
+
+		MemoryNode* freeBlock = blockNextPhys(block);
+		freeBlock->size = freeSize;
+		blockMarkFree(freeBlock);
+		insertFreeBlock(region, freeBlock);
+
+		moved += usedSize;
+		block = freeBlock;
+	}
+
+	return moved;
+}
+
+/* Compact all regions with the given attributes, returns the number of moved bytes */
+static size_t compactHeap(uint32_t attributes)
+{
+	size_t moved = 0;
+	for (size_t i = 0; i < regionCount; i++)
+	{
+		if ((regions[i]->attributes & attributes) == attributes)
+			moved += compactRegion(regions[i]);
+	}
+
+	movedMem += moved;
+	return moved;
+}
+
+/********** owner accounting **********/
+
+typedef struct HeapOwner
+{
+	const char* name;	//name of the owner (NULL if unused)
+	size_t liveMem;		//size of all allocated blocks of the owner
+	size_t peakMem;		//highest value of liveMem
+	size_t blockCount;	//number of allocated blocks of the owner
+	size_t allocCount;	//number of allocations since heap initialization
+} HeapOwner;
+
+static HeapOwner owners[HEAP_OWNER_COUNT];	//owners (index is owner ID)
+static size_t ownerCount;					//number of registered owners
+static uint32_t currentOwner;				//owner of allocations in thread mode
+
+/* Assign an allocated block to an owner */
+static void ownerAdd(MemoryNode* block, uint32_t owner)
+{
+	HeapOwner* entry = &owners[owner];
+	block->size = (block->size & ~BLOCK_OWNER_MSK) | (owner << BLOCK_OWNER_POS);
+
+	entry->liveMem += blockSize(block);
+	entry->blockCount++;
+	if (entry->liveMem > entry->peakMem)
+		entry->peakMem = entry->liveMem;
+}
+
+/* Remove an allocated block from its owner */
+static void ownerRemove(MemoryNode* block)
+{
+	HeapOwner* entry = &owners[blockOwner(block)];
+	block->size &= ~BLOCK_OWNER_MSK;
+
+	entry->liveMem -= blockSize(block);
+	entry->blockCount--;
+}
+
+/* Assign a new allocation to the current owner */
+static void ownerAlloc(MemoryNode* block)
+{
+	ownerAdd(block, currentOwner);
+	owners[currentOwner].allocCount++;
+}
+
+/********** allocation operations **********/
+
+/* Update high water mark of allocated memory */
+static inline void updatePeak(void)
+{
+	if (heapSize - freeMem > peakAllocMem)
+		peakAllocMem = heapSize - freeMem;
+}
+
+/* Allocate a block with the given (aligned) block size from a region with the given attributes (without compaction) */
+static void* searchBlock(size_t size, uint32_t attributes)
+{
+	//small blocks prefer fast regions, large blocks prefer other regions (keeps fast memory aviable for kernel objects)
+	//if no preferred region can serve the request, all other suitable regions are tried
+	bool preferFast = (attributes & HEAP_ATTR_FAST) || size < LARGE_BLOCK_SIZE;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (size_t i = 0; i < regionCount; i++)
+		{
+			HeapRegion* region = regions[i];
+
+			//region must provide all requested attributes
+			if ((region->attributes & attributes) != attributes)
+				continue;
+
+			//first pass: preferred regions only, second pass: the remaining regions
+			bool isPreferred = ((region->attributes & HEAP_ATTR_FAST) != 0) == preferFast;
+			if (isPreferred != (pass == 0))
+				continue;
+
+			void* mem = allocFromRegion(region, size);
+			if (mem != NULL)
+				return mem;
+		}
+	}
+
+	return NULL;
+}
+
+/* Allocate a block with the given (aligned) block size from a region with the given attributes */
+static void* allocBlock(size_t size, uint32_t attributes)
+{
+	void* mem = searchBlock(size, attributes);
+
+	//compact heap and try again if it contains movable blocks
+	if (mem == NULL && handleCount != 0 && compactHeap(attributes) != 0)
+		mem = searchBlock(size, attributes);
+
+	return mem;
+}
+
+static void* allocAttr(size_t size, uint32_t attributes)
+{
+	size = adjustSize(size);
+	void* mem = (size != 0) ? allocBlock(size, attributes) : NULL;
+	if (mem == NULL)
+	{
+		allocFailCount++;
+		return NULL;
+	}
+
+	ownerAlloc(memToBlock(mem));
+	blockSetAttributes(memToBlock(mem), attributes);
+	updatePeak();
+	return mem;
+}
 
-typedef struct MemoryNode
+static void* allocAligned(size_t size, uint32_t alignLog2, uint32_t attributes)
 {
-	struct MemoryNode* next;
-	size_t size;
-} MemoryNode;
+	//every block is aligned with 4 anyway
+	if (alignLog2 <= ALIGN_SIZE_LOG2)
+		return allocAttr(size, attributes);
 
-static void* heapAddress;	//heap start address
-static size_t heapSize;		//heap size
-static MemoryNode* head;	//head of the free block linked list
+	//no block can be greater than the largest manageable block size
+	size = adjustSize(size);
+	if (alignLog2 >= FL_INDEX_MAX || size == 0)
+	{
+		allocFailCount++;
+		return NULL;
+	}
 
-void heap_init(void)
+	//search a block which can hold the requested block behind a leading gap (the gap must be able to hold a free block)
+	size_t align = 1U << alignLog2;
+	void* mem = allocBlock(size + align + BLOCK_SIZE_MIN, attributes);
+	if (mem == NULL)
+	{
+		allocFailCount++;
+		return NULL;
+	}
+
+	//if memory is aligned already, return the unused tail
+	HeapRegion* region = findRegion(mem);
+	MemoryNode* block = memToBlock(mem);
+	uintptr_t alignedMem = ((uintptr_t)mem + (align-1)) & ~(uintptr_t)(align-1);
+	if (alignedMem == (uintptr_t)mem)
+	{
+		trimBlock(region, block, size);
+		ownerAlloc(block);
+		blockSetAttributes(block, attributes);
+		updatePeak();
+		return mem;
+	}
+
+	//gap must be able to hold a free block, otherwise use next aligned address
+	while (alignedMem - (uintptr_t)mem < BLOCK_SIZE_MIN)
+		alignedMem += align;
+
+	//split block into leading gap (free) and aligned block
+	size_t gapSize = alignedMem - (uintptr_t)mem;
+	MemoryNode* alignedBlock = memToBlock((void*)alignedMem);
+	alignedBlock->size = blockSize(block) - gapSize;
+	block->size = gapSize | (block->size & BLOCK_PREV_FREE_BIT);
+
+	//merge gap with previous physical block if it is free
+	if (blockIsPrevFree(block))
+	{
+		MemoryNode* prev = blockPrevPhys(block);
+		removeFreeBlock(region, prev);
+		prev->size += blockSize(block);
+		block = prev;
+	}
+
+	blockMarkFree(block);
+	insertFreeBlock(region, block);
+
+	trimBlock(region, alignedBlock, size);
+	ownerAlloc(alignedBlock);
+	blockSetAttributes(alignedBlock, attributes);
+	updatePeak();
+	return (void*)alignedMem;
+}
+
+static void releaseMem(void* mem)
 {
-	heapAddress = (void*)&_heapStart;
-	heapSize = (size_t)(&_heapSize);
-	head = (void*)(&_heapStart);
+	if (mem == NULL)
+		return;
+
+	HeapRegion* region = findRegion(mem);
+	MemoryNode* block = memToBlock(mem);
+	ownerRemove(block);
+	blockSetAttributes(block, HEAP_ATTR_ANY);
+
+	//merge with next physical block if it is free
+	MemoryNode* next = blockNextPhys(block);
+	if (blockIsFree(next))
+	{
+		removeFreeBlock(region, next);
+		block->size += blockSize(next);
+	}
+
+	//merge with previous physical block if it is free (its footer precedes the header)
+	if (blockIsPrevFree(block))
+	{
+		MemoryNode* prev = blockPrevPhys(block);
+		removeFreeBlock(region, prev);
+		prev->size += blockSize(block);
+		block = prev;
+	}
 
-	//initialize free block linked list
-	head->size = (size_t)(&_heapSize);
-	head->next = NULL;
+	blockMarkFree(block);
+	insertFreeBlock(region, block);
 }
 
-void* heap_alloc(size_t size)
+static void* reallocMem(void* mem, size_t size)
 {
-	//add block size variable (size_t)
-	size += sizeof(size_t);
+	if (mem == NULL)
+		return allocAttr(size, HEAP_ATTR_ANY);
 
-	//smallest allocable memory is size of memory node
-	if (size < sizeof(MemoryNode))
-		size = sizeof(MemoryNode);
+	if (size == 0)
+	{
+		releaseMem(mem);
+		return NULL;
+	}
 
-	//make size multiple of 4 (garanties that all addresses are aligned with 4)
-	uint32_t mod = size % 4;
-	if (mod != 0)
-		size += 4 - mod;
+	size_t newSize = adjustSize(size);
+	if (newSize == 0)
+	{
+		allocFailCount++;
+		return NULL;
+	}
 
-	//first fit algorithm
-	//search for free block >= size
-	MemoryNode *current = head, *prev = NULL;
-	while (current != NULL)
+	HeapRegion* region = findRegion(mem);
+	MemoryNode* block = memToBlock(mem);
+	size_t oldSize = blockSize(block);
+	uint32_t owner = blockOwner(block);
+	uint32_t attributes = blockAttributes(block);
+	ownerRemove(block);
+
+	//grow into next physical block if it is free and large enough
+	if (newSize > oldSize)
 	{
-		if (current->size >= size)
-			break;
+		MemoryNode* next = blockNextPhys(block);
+		if (blockIsFree(next) && oldSize + blockSize(next) >= newSize)
+		{
+			removeFreeBlock(region, next);
+			block->size += blockSize(next);
+		}
+	}
 
-		prev = current;
-		current = current->next;
+	//block is large enough (shrink request or grown in place), free the tail
+	if (blockSize(block) >= newSize)
+	{
+		trimBlock(region, block, newSize);
+		ownerAdd(block, owner);
+		blockSetAttributes(block, attributes);
+		owners[owner].allocCount++;
+		updatePeak();
+		return mem;
 	}
 
-	//if no block found (current = NULL), return NULL
-	if (current == NULL)
+	//move block, the new block gets the attributes requested for the old one (both blocks exist during copy, so peak is updated before free)
+	//the new block gets the owner of the old block
+	ownerAdd(block, owner);
+	uint32_t prevOwner = currentOwner;
+	currentOwner = owner;
+	void* newMem = allocAttr(size, attributes);
+	currentOwner = prevOwner;
+	if (newMem == NULL)
 		return NULL;
 
-	//if block size is equal or lesser than block size + node size (because min size of block is size of MemoryNode), use full block
-	if ( (current->size - size) < sizeof(MemoryNode) )
+	util_memcpy(mem, newMem, oldSize - BLOCK_HEADER_SIZE);
+	releaseMem(mem);
+
+	return newMem;
+}
+
+/********** allocation trace **********/
+
+#ifdef HEAPTRACE
+
+static Heap_TraceEntry traceBuffer[HEAP_TRACE_ENTRY_COUNT];	//ring buffer of the last trace entries
+static uint32_t traceCount;									//number of recorded entries (including overwritten entries)
+
+static void traceRecord(HEAP_TRACE_TYPE type, size_t size, uint32_t arg, const void* mem, const void* oldMem, uint32_t startCycle, const void* caller)
+{
+	uint32_t endCycle = DWT->CYCCNT;
+
+	Heap_TraceEntry* entry = &traceBuffer[traceCount % HEAP_TRACE_ENTRY_COUNT];
+	entry->type = type;
+	entry->timestamp = startCycle;
+	entry->cycles = endCycle - startCycle;
+	entry->caller = caller;
+	entry->size = size;
+	entry->arg = arg;
+	entry->mem = mem;
+	entry->oldMem = oldMem;
+
+	traceCount++;
+}
+
+#define TRACE_BEGIN() uint32_t traceStartCycle = DWT->CYCCNT
+#define TRACE_END(type, size, arg, mem, oldMem) traceRecord(type, size, arg, mem, oldMem, traceStartCycle, __builtin_return_address(0))
+
+#else
+
+#define TRACE_BEGIN()
+#define TRACE_END(type, size, arg, mem, oldMem)
+
+#endif
+
+/********** interrupt-safe allocation **********/
+
+typedef struct IsrPool
+{
+	size_t size;				//size of the pool blocks (0 if pool is unused)
+	uint32_t attributes;		//attributes of the pool blocks
+	size_t target;				//number of blocks which should be aviable
+	volatile uint32_t count;	//number of aviable blocks
+	Atomic_Node* volatile head;	//stack of aviable blocks
+} IsrPool;
+
+typedef struct IsrPoolOrder
+{
+	uint32_t count;						//number of used pools
+	uint8_t pools[HEAP_ISR_POOL_COUNT];	//indices of the used pools ordered by block size
+} IsrPoolOrder;
+
+static IsrPool isrPools[HEAP_ISR_POOL_COUNT];	//pools in order of reservation (a used pool never moves, interrupts may use its stack)
+static IsrPoolOrder isrPoolOrders[2];			//current and next search order of the pools
+static const IsrPoolOrder* volatile isrPoolOrder;	//current search order (read once per interrupt allocation)
+static Atomic_Node* volatile deferredFrees;		//stack of blocks which were freed in handler mode
+static volatile bool poolsNeedRefill;			//set if a block was taken from a pool
+
+/* Returns true if called from an exception handler */
+static inline bool inHandlerMode(void)
+{
+	return __get_IPSR() != 0;
+}
+
+/* Allocate memory in handler mode from the smallest suitable pool */
+static void* isrAlloc(size_t size, uint32_t attributes)
+{
+	const IsrPoolOrder* order = isrPoolOrder;
+	for (size_t i = 0; i < order->count; i++)
 	{
-		if (prev != NULL) //if current is not head
+		IsrPool* pool = &isrPools[order->pools[i]];
+		if (pool->size < size || (pool->attributes & attributes) != attributes)
+			continue;
+
+		Atomic_Node* node = atomic_pop(&pool->head);
+		if (node != NULL)
 		{
-			prev->next = current->next; //remove node current from list
+			atomic_add(&pool->count, -1);
+			poolsNeedRefill = true;
+			return node;
+		}
+	}
 
+	return NULL;
+}
+
+/* Free blocks which were freed in handler mode and refill pools (thread mode only) */
+static void processDeferred(void)
+{
+	//release deferred blocks
+	if (deferredFrees != NULL)
+	{
+		Atomic_Node* node = atomic_takeAll(&deferredFrees);
+		while (node != NULL)
+		{
+			Atomic_Node* next = node->next;
+			TRACE_BEGIN();
+			releaseMem(node);
+			TRACE_END(HEAP_TRACE_DEFERRED_FREE, 0, 0, NULL, node);
+			node = next;
 		}
-		else //if current is head, complete first free block is allocated now
+	}
+
+	//refill pools (pool blocks have no owner)
+	if (poolsNeedRefill)
+	{
+		uint32_t prevOwner = currentOwner;
+		currentOwner = HEAP_OWNER_NONE;
+		poolsNeedRefill = false;
+		for (size_t i = 0; i < HEAP_ISR_POOL_COUNT; i++)
 		{
-			head = current->next;
+			IsrPool* pool = &isrPools[i];
+			while (pool->size != 0 && pool->count < pool->target)
+			{
+				TRACE_BEGIN();
+				Atomic_Node* node = allocAttr(pool->size, pool->attributes);
+				TRACE_END(HEAP_TRACE_POOL_ALLOC, pool->size, pool->attributes, node, NULL);
+				if (node == NULL)
+				{
+					//try again at next call
+					poolsNeedRefill = true;
+					break;
+				}
+
+				atomic_push(&pool->head, node);
+				atomic_add(&pool->count, 1);
+			}
 		}
+		currentOwner = prevOwner;
+	}
+}
+
+/********** heap interface **********/
+
+void heap_init(void)
+{
+#ifdef HEAPTRACE
+	//enable cycle counter for trace timestamps
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	traceCount = 0;
+#endif
+
+	regionCount = 0;
+	heapSize = 0;
+	freeMem = 0;
+	allocFailCount = 0;
+	movedMem = 0;
 
-		*((size_t*)current) = current->size; //write block size
-		return (size_t*)current + 1; //first bytes represents size of block
+	for (size_t i = 0; i < HEAP_OWNER_COUNT; i++)
+	{
+		owners[i].name = NULL;
+		owners[i].liveMem = 0;
+		owners[i].peakMem = 0;
+		owners[i].blockCount = 0;
+		owners[i].allocCount = 0;
+	}
+	owners[HEAP_OWNER_NONE].name = "none";
+	ownerCount = 1;
+	currentOwner = HEAP_OWNER_NONE;
+
+	for (size_t i = 0; i < HEAP_HANDLE_COUNT; i++)
+	{
+		handles[i].block = NULL;
+		handles[i].pinCount = 0;
 	}
-	else //if block is greater than block size + node size, split block
+	handleCount = 0;
+
+	for (size_t i = 0; i < HEAP_ISR_POOL_COUNT; i++)
+	{
+		isrPools[i].size = 0;
+		isrPools[i].count = 0;
+		isrPools[i].target = 0;
+		isrPools[i].head = NULL;
+	}
+	isrPoolOrders[0].count = 0;
+	isrPoolOrder = &isrPoolOrders[0];
+	deferredFrees = NULL;
+	poolsNeedRefill = false;
+
+	//create a region for every memory section, memory in use by the kernel image (data, bss, stack, RAM vector table and code in RAM mode)
+	//is excluded, these sections are placed at the beginning of a memory section by the linker script
+	for (size_t i = 0; i < device_memoryMapEntryCount; i++)
 	{
-		MemoryNode* node = (MemoryNode*)((uint8_t*)current + size);
-		node->next = current->next;
-		node->size = current->size - size;
+		const Device_MemorySection* section = &device_memoryMap[i];
+		uint8_t* start = section->start;
+		uint8_t* end = start + section->size;
 
-		if (prev != NULL) //if current is not head
-			prev->next = node;
-		else //if current is head
-			head = node;
+		if (overlaps(start, end, &_textStart, &_textEnd))
+			start = (uint8_t*)&_textEnd;
+		if (overlaps(start, end, &_ivectorRamStart, &_ivectorRamEnd))
+			start = (uint8_t*)&_ivectorRamEnd;
+		if (overlaps(start, end, &_dataStart, &_dataEnd))
+			start = (uint8_t*)&_dataEnd;
+		if (overlaps(start, end, &_bssStart, &_bssEnd))
+			start = (uint8_t*)&_bssEnd;
+		if (overlaps(start, end, &_stackEnd, &_stackStart))
+			start = (uint8_t*)&_stackStart;
 
-		*((size_t*)current) = size;
-		return (size_t*)current + 1;
+		if (start < end)
+			addRegion(start, end - start, section->attributes);
 	}
+
+	//control structures and sentinel blocks are allocated memory
+	peakAllocMem = heapSize - freeMem;
+}
+
+void* heap_alloc(size_t size)
+{
+	if (inHandlerMode())
+		return isrAlloc(size, HEAP_ATTR_ANY);
+
+	processDeferred();
+
+	TRACE_BEGIN();
+	void* mem = allocAttr(size, HEAP_ATTR_ANY);
+	TRACE_END(HEAP_TRACE_ALLOC, size, HEAP_ATTR_ANY, mem, NULL);
+	return mem;
+}
+
+void* heap_allocAttr(size_t size, uint32_t attributes)
+{
+	if (inHandlerMode())
+		return isrAlloc(size, attributes);
+
+	processDeferred();
+
+	TRACE_BEGIN();
+	void* mem = allocAttr(size, attributes);
+	TRACE_END(HEAP_TRACE_ALLOC, size, attributes, mem, NULL);
+	return mem;
+}
+
+void* heap_allocAligned(size_t size, uint32_t alignLog2, uint32_t attributes)
+{
+	//not supported in handler mode
+	if (inHandlerMode())
+		return NULL;
+
+	processDeferred();
+
+	TRACE_BEGIN();
+	void* mem = allocAligned(size, alignLog2, attributes);
+	TRACE_END(HEAP_TRACE_ALLOC_ALIGNED, size, (alignLog2 << 16) | attributes, mem, NULL);
+	return mem;
 }
 
 void heap_free(void* mem)
@@ -111,130 +1140,224 @@ void heap_free(void* mem)
 	if (mem == NULL)
 		return;
 
-	//set to real block address (first bytes are block size)
-	mem = ((size_t*)mem - 1);
+	//blocks freed in handler mode are released at the next heap call in thread mode
+	if (inHandlerMode())
+	{
+		atomic_push(&deferredFrees, mem);
+		return;
+	}
+
+	processDeferred();
+
+	TRACE_BEGIN();
+	releaseMem(mem);
+	TRACE_END(HEAP_TRACE_FREE, 0, 0, NULL, mem);
+}
+
+void* heap_realloc(void* mem, size_t size)
+{
+	//not supported in handler mode
+	if (inHandlerMode())
+		return NULL;
+
+	processDeferred();
 
-	//get block size
-	size_t size = *((size_t*)mem);
+	TRACE_BEGIN();
+	void* newMem = reallocMem(mem, size);
+	TRACE_END(HEAP_TRACE_REALLOC, size, 0, newMem, mem);
+	return newMem;
+}
 
-	//initialize new node
-	MemoryNode* current = mem;
-	//next pointer and size will be inititalized later
+error_t heap_reserveIsrPool(size_t size, size_t count, uint32_t attributes)
+{
+	if (inHandlerMode() || size == 0)
+		return ERROR_INVALID_ARGUMENT;
 
-	//search gap for inserting new node
-	//free block list is ordered by address
-	MemoryNode* prev = NULL, *next = head;
-	while (next != NULL)
+	//find pool with same size and attributes or unused pool
+	size_t index;
+	for (index = 0; index < HEAP_ISR_POOL_COUNT; index++)
 	{
-		if ((uint8_t*)next > (uint8_t*)mem)
+		if (isrPools[index].size == 0 || (isrPools[index].size == size && isrPools[index].attributes == attributes))
 			break;
-
-		prev = next;
-		next = next->next;
 	}
 
-	//check if neighbour nodes need to merge with current
-	if (next != NULL)
+	if (index == HEAP_ISR_POOL_COUNT)
+		return ERROR_HEAP_NO_ISR_POOL_LEFT;
+
+	IsrPool* pool = &isrPools[index];
+	if (pool->size == 0)
 	{
-		if (prev != NULL)
-		{
-			//next and prev aren't NULL
+		pool->size = size;
+		pool->attributes = attributes;
+		pool->target = 0;
+		pool->count = 0;
+		pool->head = NULL;
 
-			//prev with current
-			if ( ((uint8_t*)prev + prev->size) == (uint8_t*)current )
-			{
-				//current with next
-				if ( ((uint8_t*)next - size) == (uint8_t*)current )
-				{
-					//all three nodes need to merge
-					prev->size += size + next->size;
-					prev->next = next->next;
-					return;
-				}
-				else
-				{
-					//prev and current need to merge
-					prev->size += size;
-					//prev->next = next; already done
-					return;
-				}
-			}
-			else
-			{
-				//current with next
-				if ( ((uint8_t*)next - size) == (uint8_t*)current )
-				{
-					//current and next need to merge
-					current->size = size + next->size;
-					current->next = next->next;
-					prev->next = current;
-					return;
-				}
-				else
-				{
-					//no need to merge
-					current->size = size;
-					current->next = next;
-					prev->next = current;
-					return;
-				}
-			}
-		}
-		else
+		//interrupts may search the pools meanwhile, so the new search order is built in the unused buffer and published at once
+		//(the pools themselves are never copied, a block on their stacks can't be handed out twice)
+		const IsrPoolOrder* current = isrPoolOrder;
+		IsrPoolOrder* next = (current == &isrPoolOrders[0]) ? &isrPoolOrders[1] : &isrPoolOrders[0];
+		bool inserted = false;
+		next->count = 0;
+		for (size_t i = 0; i < current->count; i++)
 		{
-			//prev is NULL, next is not, current block is at heap start address
-
-			//current with next
-			if ( ((uint8_t*)next - size) == (uint8_t*)current )
+			if (!inserted && isrPools[current->pools[i]].size > size)
 			{
-				//current and next need to merge
-				current->size = size + next->size;
-				current->next = next->next;
-				head = current;
-				return;
-			}
-			else
-			{
-				//no need to merge
-				current->size = size;
-				current->next = next;
-				head = current;
-				return;
+				next->pools[next->count++] = index;
+				inserted = true;
 			}
+			next->pools[next->count++] = current->pools[i];
 		}
+		if (!inserted)
+			next->pools[next->count++] = index;
+
+		__DMB();
+		isrPoolOrder = next;
 	}
-	else
+
+	//reserve blocks now, so they are aviable for the next interrupt
+	pool->target += count;
+	poolsNeedRefill = true;
+	processDeferred();
+
+	if (pool->count < pool->target)
+		return ERROR_HEAP_OUT_OF_MEMORY;
+
+	return ERROR_NONE;
+}
+
+void heap_processDeferred(void)
+{
+	if (!inHandlerMode())
+		processDeferred();
+}
+
+Heap_Handle heap_allocMovable(size_t size, uint32_t attributes)
+{
+	if (inHandlerMode() || handleCount >= HEAP_HANDLE_COUNT || size > heapSize)
+		return NULL;
+
+	processDeferred();
+
+	Heap_Handle handle = handles;
+	while (handle->block != NULL)
+		handle++;
+
+	//the block starts with a pointer to its handle
+	TRACE_BEGIN();
+	void* mem = allocAttr(size + MOVABLE_HEADER_SIZE, attributes);
+	if (mem == NULL)
 	{
-		//next is NULL, prev could be
-		if (prev != NULL)
-		{
-			//next is NULL, prev is not, current block is new tail
+		TRACE_END(HEAP_TRACE_ALLOC_MOVABLE, size, attributes, NULL, NULL);
+		return NULL;
+	}
 
-			//prev with current
-			if ( ((uint8_t*)prev + prev->size) == (uint8_t*)current )
-			{
-				prev->size += size;
-				return;
-			}
-			else
-			{
-				//no need to merge
-				current->size = size;
-				current->next = NULL;
-				prev->next = current;
-				return;
-			}
+	*(Heap_Handle*)mem = handle;
+	handle->block = memToBlock(mem);
+	handle->pinCount = 0;
+	handleCount++;
 
-		}
-		else
-		{
-			//next and prev are NULL, no block is free, current is new head
-			current->size = size;
-			current->next = NULL;
-			head = current;
-			return;
-		}
+	TRACE_END(HEAP_TRACE_ALLOC_MOVABLE, size, attributes, handle, NULL);
+	return handle;
+}
+
+void heap_freeMovable(Heap_Handle handle)
+{
+	if (handle == NULL || inHandlerMode())
+		return;
+
+	processDeferred();
+
+	TRACE_BEGIN();
+	releaseMem(blockToMem(handle->block));
+	handle->block = NULL;
+	handle->pinCount = 0;
+	handleCount--;
+	TRACE_END(HEAP_TRACE_FREE_MOVABLE, 0, 0, NULL, handle);
+}
+
+void* heap_pin(Heap_Handle handle)
+{
+	handle->pinCount++;
+	return (uint8_t*)blockToMem(handle->block) + MOVABLE_HEADER_SIZE;
+}
+
+void heap_unpin(Heap_Handle handle)
+{
+	if (handle->pinCount > 0)
+		handle->pinCount--;
+}
+
+size_t heap_compact(void)
+{
+	if (inHandlerMode())
+		return 0;
+
+	processDeferred();
+
+	TRACE_BEGIN();
+	size_t moved = compactHeap(HEAP_ATTR_ANY);
+	TRACE_END(HEAP_TRACE_COMPACT, moved, 0, NULL, NULL);
+	return moved;
+}
+
+uint32_t heap_registerOwner(const char* name)
+{
+	//owners are identified by name, so a module can register again after reinitialization
+	for (size_t i = 0; i < ownerCount; i++)
+	{
+		if (util_strcmp(owners[i].name, name) == 0)
+			return i;
 	}
+
+	if (ownerCount >= HEAP_OWNER_COUNT)
+		return HEAP_OWNER_NONE;
+
+	owners[ownerCount].name = name;
+	return ownerCount++;
+}
+
+uint32_t heap_setCurrentOwner(uint32_t owner)
+{
+	uint32_t prevOwner = currentOwner;
+	if (owner < ownerCount && !inHandlerMode())
+		currentOwner = owner;
+
+	return prevOwner;
+}
+
+error_t heap_setOwner(void* mem, uint32_t owner)
+{
+	if (mem == NULL || owner >= ownerCount || inHandlerMode())
+		return ERROR_INVALID_ARGUMENT;
+
+	MemoryNode* block = memToBlock(mem);
+	owners[blockOwner(block)].allocCount--;
+	ownerRemove(block);
+	ownerAdd(block, owner);
+	owners[owner].allocCount++;
+
+	return ERROR_NONE;
+}
+
+size_t heap_getOwnerCount(void)
+{
+	return ownerCount;
+}
+
+error_t heap_getOwnerStats(uint32_t owner, Heap_OwnerStats* outStats)
+{
+	if (owner >= ownerCount)
+		return ERROR_INVALID_INDEX;
+
+	const HeapOwner* entry = &owners[owner];
+	outStats->name = entry->name;
+	outStats->liveMem = entry->liveMem;
+	outStats->peakMem = entry->peakMem;
+	outStats->blockCount = entry->blockCount;
+	outStats->allocCount = entry->allocCount;
+
+	return ERROR_NONE;
 }
 
 void heap_getStats(size_t* outHeapSize, size_t* outAllocMem, size_t* outFreeMem)
@@ -242,21 +1365,101 @@ void heap_getStats(size_t* outHeapSize, size_t* outAllocMem, size_t* outFreeMem)
 	if (outHeapSize != NULL)
 		*outHeapSize = heapSize;
 
-	if (outAllocMem != NULL || outFreeMem != NULL)
+	if (outAllocMem != NULL)
+		*outAllocMem = heapSize - freeMem;
+
+	if (outFreeMem != NULL)
+		*outFreeMem = freeMem;
+}
+
+void heap_getDetailedStats(Heap_Stats* outStats)
+{
+	outStats->heapSize = heapSize;
+	outStats->allocMem = heapSize - freeMem;
+	outStats->freeMem = freeMem;
+	outStats->peakAllocMem = peakAllocMem;
+	outStats->largestFreeBlock = 0;
+	outStats->freeBlockCount = 0;
+	outStats->allocFailCount = allocFailCount;
+	outStats->movedMem = movedMem;
+
+	for (size_t i = 0; i < regionCount; i++)
 	{
-		//calculate free memory
-		size_t freeMem = 0;
-		MemoryNode* current = head;
-		while (current != NULL)
-		{
-			freeMem += current->size;
-			current = current->next;
-		}
+		size_t largest = regionLargestFreeBlock(regions[i]);
+		if (largest > outStats->largestFreeBlock)
+			outStats->largestFreeBlock = largest;
+
+		outStats->freeBlockCount += regions[i]->freeBlockCount;
+	}
+
+	//fragmentation index: 0 if all free memory is one block, approaches 1000 if free memory is split into many small blocks
+	//(no overflow, blocks are smaller than 1<<FL_INDEX_MAX)
+	if (freeMem != 0)
+		outStats->fragmentation = 1000 - (outStats->largestFreeBlock * 1000) / freeMem;
+	else
+		outStats->fragmentation = 0;
+}
+
+size_t heap_getRegionCount(void)
+{
+	return regionCount;
+}
+
+error_t heap_getRegionStats(size_t index, uint32_t* outAttributes, size_t* outRegionSize, size_t* outAllocMem, size_t* outFreeMem)
+{
+	if (index >= regionCount)
+		return ERROR_INVALID_INDEX;
+
+	const HeapRegion* region = regions[index];
+	size_t regionSize = region->end - region->start;
+
+	if (outAttributes != NULL)
+		*outAttributes = region->attributes;
+
+	if (outRegionSize != NULL)
+		*outRegionSize = regionSize;
 
-		if (outAllocMem != NULL)
-			*outAllocMem = heapSize - freeMem;
+	if (outAllocMem != NULL)
+		*outAllocMem = regionSize - region->freeMem;
 
-		if (outFreeMem != NULL)
-			*outFreeMem = freeMem;
+	if (outFreeMem != NULL)
+		*outFreeMem = region->freeMem;
+
+	return ERROR_NONE;
+}
+
+#ifdef HEAPTRACE
+
+size_t heap_getTraceCount(void)
+{
+	return traceCount;
+}
+
+const Heap_TraceEntry* heap_getTraceEntry(size_t index)
+{
+	//only the last HEAP_TRACE_ENTRY_COUNT entries are aviable
+	if (index >= traceCount || traceCount - index > HEAP_TRACE_ENTRY_COUNT)
+		return NULL;
+
+	return &traceBuffer[index % HEAP_TRACE_ENTRY_COUNT];
+}
+
+#ifdef DEBUG
+void heap_dumpTrace(void)
+{
+	static const char* typeNames[] = { "alloc", "aligned", "realloc", "free", "poolalloc", "deferredfree", "movable", "freemovable", "compact" };
+
+	//one line per entry: type timestamp cycles caller size arg mem oldMem (numbers are hexadecimal)
+	size_t first = (traceCount > HEAP_TRACE_ENTRY_COUNT) ? traceCount - HEAP_TRACE_ENTRY_COUNT : 0;
+	debug_printf("heaptrace begin %x %x\n", first, traceCount);
+	for (size_t i = first; i < traceCount; i++)
+	{
+		const Heap_TraceEntry* entry = &traceBuffer[i % HEAP_TRACE_ENTRY_COUNT];
+		debug_printf("heaptrace %s %x %x %x %x %x %x %x\n", typeNames[entry->type], entry->timestamp, entry->cycles,
+					 entry->caller, entry->size, entry->arg, entry->mem, entry->oldMem);
 	}
+	debug_printf("heaptrace end\n");
 }
+#endif
+
+#endif
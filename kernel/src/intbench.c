@@ -0,0 +1,186 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel interrupt benchmark module.
+ *
+ * The measured latency includes the NVIC software trigger, exception entry (stacking, vector fetch from the RAM vector table)
+ * and the prologue of the handler. QEMU doesn't model the DWT cycle counter nor exact timing, results under QEMU only show
+ * that the handler is dispatched directly, the cycle numbers need real hardware.
+ */
+
+#include <intbench.h>
+#include <interrupt.h>
+#include <debug.h>
+#include <device.h>
+
+/**
+ * @brief IRQ used by intbench_runSuite (must be unused by the drivers).
+ */
+#ifndef INTBENCH_IRQ
+#define INTBENCH_IRQ HASH_RNG_IRQn
+#endif
+
+/**
+ * @brief Priority used by intbench_runSuite, above the kernel ceiling so critical sections don't delay the entry.
+ */
+#ifndef INTBENCH_PRIORITY
+#define INTBENCH_PRIORITY (INT_KERNEL_CEILING_PRIORITY-1)
+#endif
+
+#define SUITE_SAMPLES 256
+
+/**
+ * @brief Busy loops until a pended IRQ counts as not delivered.
+ */
+#define DELIVERY_TIMEOUT 100000
+
+#define SYSTICK_MASK 0xFFFFFF
+
+static bool useSysTick;
+static volatile uint32_t entryTimestamp;
+static volatile bool entered;
+
+static inline uint32_t timestamp(void)
+{
+	//SysTick counts down from SYSTICK_MASK
+	return useSysTick ? (SYSTICK_MASK - SysTick->VAL) : DWT->CYCCNT;
+}
+
+static inline uint32_t elapsed(uint32_t start, uint32_t end)
+{
+	return useSysTick ? ((end - start) & SYSTICK_MASK) : (end - start);
+}
+
+static void handleIrq(void)
+{
+	entryTimestamp = timestamp();
+	entered = true;
+}
+
+static bool counterRuns(void)
+{
+	uint32_t start = timestamp();
+	for (volatile uint32_t i = 0; i < 16; i++) {}
+	return timestamp() != start;
+}
+
+error_t intbench_run(int32_t irqNum, uint8_t priority, uint32_t samples, Intbench_Result* result)
+{
+	if (samples == 0 || irqNum < 0)
+		return ERROR_INVALID_ARGUMENT;
+
+	/********** select a running counter **********/
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	useSysTick = false;
+
+	//SysTick isn't used by the kernel, the configuration is restored after the run anyway
+	uint32_t sysTickCtrl = SysTick->CTRL;
+	uint32_t sysTickLoad = SysTick->LOAD;
+	if (!counterRuns())
+	{
+		useSysTick = true;
+		SysTick->LOAD = SYSTICK_MASK;
+		SysTick->VAL = 0;
+		SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk; //core clock, no interrupt
+		if (!counterRuns())
+		{
+			SysTick->CTRL = sysTickCtrl;
+			SysTick->LOAD = sysTickLoad;
+			return ERROR_INTBENCH_NO_COUNTER;
+		}
+	}
+
+	uint32_t start = timestamp();
+	uint32_t overhead = elapsed(start, timestamp());
+	uint32_t min = UINT32_MAX;
+	uint32_t max = 0;
+	uint32_t total = 0;
+
+	error_t error = int_setHandler(irqNum, handleIrq);
+	if (error == ERROR_NONE)
+	{
+		int_enable(irqNum, priority);
+
+		for (uint32_t i = 0; i < samples; i++)
+		{
+			entered = false;
+			start = timestamp();
+			NVIC->STIR = (uint32_t)irqNum;
+			__DSB();
+			__ISB();
+
+			for (uint32_t wait = 0; !entered && wait < DELIVERY_TIMEOUT; wait++) {}
+			if (!entered)
+			{
+				error = ERROR_INTBENCH_NOT_DELIVERED;
+				break;
+			}
+
+			uint32_t cycles = elapsed(start, entryTimestamp);
+			cycles = (cycles > overhead) ? cycles - overhead : 0;
+			min = (cycles < min) ? cycles : min;
+			max = (cycles > max) ? cycles : max;
+			total += cycles;
+		}
+
+		int_disable(irqNum);
+		int_setHandler(irqNum, NULL);
+	}
+
+	if (error == ERROR_NONE)
+	{
+		result->samples = samples;
+		result->minCycles = min;
+		result->avgCycles = total / samples;
+		result->maxCycles = max;
+		result->overheadCycles = overhead;
+		result->sysTick = useSysTick;
+	}
+
+	if (useSysTick)
+	{
+		SysTick->CTRL = sysTickCtrl;
+		SysTick->LOAD = sysTickLoad;
+	}
+
+	return error;
+}
+
+#ifdef DEBUG
+error_t intbench_runSuite(void)
+{
+	Intbench_Result result;
+	error_t error = intbench_run(INTBENCH_IRQ, INTBENCH_PRIORITY, SUITE_SAMPLES, &result);
+	if (error != ERROR_NONE)
+	{
+		debug_printf("intbench failed with error %i\n", error);
+		return error;
+	}
+
+	//irq counter samples min avg max overhead (cycles, numbers are decimal)
+	debug_printf("intbench %i %s %i %i %i %i %i\n", INTBENCH_IRQ, result.sysTick ? "systick" : "dwt",
+			result.samples, result.minCycles, result.avgCycles, result.maxCycles, result.overheadCycles);
+	return ERROR_NONE;
+}
+#endif
@@ -24,6 +24,8 @@
 /* Kernel interrupt (int) module.
  *
  * Manages interrupt vector table and the access of it.
+ * The vector table in ROM (system handlers and the extended vector table of drivers) is only used until int_init,
+ * int_init copies it into a vector table in RAM with an entry for every interrupt of the device, int_setHandler writes into this table.
  */
 
 #include <interrupt.h>
@@ -37,6 +39,21 @@ const static char moduleName[] = "int";
  */
 #define TBLBASE (1<<29)
 
+/**
+ * @brief Index of a system interrupt in the SHP registers of the SCB (starts with the memory managment fault, exception number 4).
+ */
+#define SHP_INDEX(irqNum) (INT_IRQ_EXCPT_NUM(irqNum)-4)
+
+/**
+ * @brief Number of IRQs of the device.
+ */
+#define IRQ_COUNT (DEVICE_INT_COUNT-INT_IRQ_EXCPT_START)
+
+/**
+ * @brief Alignment of the vector table in RAM, the table size rounded up to the next power of 2 (see VTOR).
+ */
+#define VECTOR_TABLE_ALIGN 512
+
 /* Deklaration of basic interrupt handlers */
 void handler_default(void);
 void handler_reset(void);
@@ -54,12 +71,10 @@ void __attribute__((weak)) handler_systick(void);
  */
 static uint32_t oldVectorAddress = 0;
 
-typedef void (*IntHandler)(void);
-
 /**
  * @brief The interrupt vector table.
  */
-__attribute__ ((section (".ivector"))) const IntHandler ivectorTable[16] =
+__attribute__ ((section (".ivector"))) const Int_Handler ivectorTable[16] =
 {
 	(void*)&_stackStart,	//stack start pointer
 	handler_reset,			//Reset handler
@@ -79,6 +94,11 @@ __attribute__ ((section (".ivector"))) const IntHandler ivectorTable[16] =
 	handler_systick			//SysTick handler
 };
 
+/**
+ * @brief The interrupt vector table in RAM (see int_setHandler).
+ */
+static __attribute__ ((section (".ivector_ram"), aligned (VECTOR_TABLE_ALIGN))) Int_Handler ramVectorTable[DEVICE_INT_COUNT];
+
 #pragma weak handler_nmi = handler_default
 #pragma weak handler_hardfault = handler_default
 #pragma weak handler_mmufault = handler_default
@@ -97,9 +117,8 @@ void int_init(void)
 {
 	uint32_t tmp;
 
-	/********** disable interrupts **********/
-	__disable_fault_irq();
-	__disable_irq();
+	/********** mask interrupts with kernel priority (faults and interrupts above the ceiling can't use the kernel yet anyway) **********/
+	uint32_t state = int_enterCritical();
 
 	/********** initialize system control register (interrupt specific register) **********/
 
@@ -117,15 +136,27 @@ void int_init(void)
 
 	/********** disable all IRQs **********/
 	for (size_t reg = 0; reg <= 7; reg++)
-		NVIC->ICER[reg] = 0;
+		NVIC->ICER[reg] = 0xFFFFFFFF;
 
 	/********** save old interrupt vector table address **********/
 	oldVectorAddress = SCB->VTOR;
 
+	/********** copy interrupt vector table (including the extended vector table) to RAM, missing entries get the default handler **********/
+	const Int_Handler* romVector = ivectorTable;
+	for (size_t i = 0; i < DEVICE_INT_COUNT; i++)
+	{
+		if (romVector < (const Int_Handler*)&_ivectorEnd)
+			ramVectorTable[i] = *romVector++;
+		else
+			ramVectorTable[i] = handler_default;
+	}
+
 	/********** sets new interrupt vector table (set TBLBASE bit because interrupt vector table is in SRAM) **********/
-	SCB->VTOR = ( ( (uint32_t)ivectorTable) | TBLBASE ) & SCB_VTOR_TBLOFF_Msk;
+	SCB->VTOR = ( ( (uint32_t)ramVectorTable) | TBLBASE ) & SCB_VTOR_TBLOFF_Msk;
+	__DSB();
 
-	/********** enable interrupts **********/
+	/********** enable interrupts (also the global masks set by kernel_start) **********/
+	int_exitCritical(state);
 	__enable_irq();
 	__enable_fault_irq();
 }
@@ -151,39 +182,39 @@ void int_enable(int32_t irqNum, uint8_t priority)
 		{
 		case INT_MMUFAULT:
 			tmp |= SCB_SHCSR_MEMFAULTENA_Msk;
-			SCB->SHP[4] = priority;
+			SCB->SHP[SHP_INDEX(irqNum)] = priority;
 			break;
 
 		case INT_BUSFAULT:
 			tmp |= SCB_SHCSR_BUSFAULTENA_Msk;
-			SCB->SHP[5] = priority;
+			SCB->SHP[SHP_INDEX(irqNum)] = priority;
 			break;
 
 		case INT_USAGEFAULT:
 			tmp |= SCB_SHCSR_USGFAULTENA_Msk;
-			SCB->SHP[6] = priority;
+			SCB->SHP[SHP_INDEX(irqNum)] = priority;
 			break;
 
 		case INT_SVCALL:
 			//interrupt is always enabled
-			SCB->SHP[11] = priority;
+			SCB->SHP[SHP_INDEX(irqNum)] = priority;
 			break;
 
 		case INT_PENDSV:
 			//interrupt is always enabled
-			SCB->SHP[14] = priority;
+			SCB->SHP[SHP_INDEX(irqNum)] = priority;
 			break;
 
 		case INT_SYSTICK:
 			//interrupt is always enabled
-			SCB->SHP[15] = priority;
+			SCB->SHP[SHP_INDEX(irqNum)] = priority;
 			break;
 		}
 
 		SCB->SHCSR = tmp;
 	}
 	//IRQ interrupt
-	else if (irqNum <= DEVICE_INT_COUNT)
+	else if (irqNum < IRQ_COUNT)
 	{
 		NVIC->IP[irqNum] = priority;
 		NVIC_EnableIRQ(irqNum);
@@ -193,7 +224,7 @@ void int_enable(int32_t irqNum, uint8_t priority)
 void int_disable(int32_t irqNum)
 {
 	//IRQ interrupt
-	if ( irqNum >= 0 && irqNum <= DEVICE_INT_COUNT )
+	if ( irqNum >= 0 && irqNum < IRQ_COUNT )
 	{
 		NVIC_DisableIRQ(irqNum);
 		return;
@@ -217,3 +248,44 @@ void int_disable(int32_t irqNum)
 	}
 	SCB->SHCSR = tmp;
 }
+
+error_t int_setHandler(int32_t irqNum, Int_Handler handler)
+{
+	if (irqNum <= INT_RESET || irqNum >= IRQ_COUNT)
+		return ERROR_INVALID_INDEX;
+
+	Int_Handler* vector = &ramVectorTable[INT_IRQ_EXCPT_NUM(irqNum)];
+
+	//reserved entries
+	if (*vector == NULL)
+		return ERROR_INVALID_INDEX;
+
+	if (handler == NULL)
+	{
+		if (*vector == handler_default)
+			return ERROR_INT_NOT_USED_YET;
+		handler = handler_default;
+	}
+	else if (*vector != handler_default)
+		return ERROR_INT_ALREADY_IN_USE;
+
+	//a single word write, the next exception entry fetches the new handler after the barrier
+	*vector = handler;
+	__DSB();
+
+	return ERROR_NONE;
+}
+
+uint32_t int_enterCritical(void)
+{
+	uint32_t state = __get_BASEPRI();
+
+	//never lowers the mask, so nested sections and sections in handlers of high priority keep their mask
+	__set_BASEPRI_MAX(INT_KERNEL_CEILING_PRIORITY << (8 - __NVIC_PRIO_BITS));
+	return state;
+}
+
+void int_exitCritical(uint32_t state)
+{
+	__set_BASEPRI(state);
+}
@@ -0,0 +1,190 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel I/O scheduler module.
+ *
+ * The elevator policy keeps queued requests in a list sorted by offset. Dispatching starts at the first
+ * request behind the current position, walks up to the end of the list and wraps around to its head.
+ * A run of requests of the same type whose offsets are contiguous becomes one vectored operation.
+ */
+
+#include <iosched.h>
+
+/* Remove a request from the queue */
+static void removeRequest(Iosched_Queue* queue, Dev_Request* request)
+{
+	Dev_Request** link = &queue->requests;
+	while (*link != request)
+		link = &(*link)->next;
+
+	*link = request->next;
+	queue->depth--;
+}
+
+/* Execute a request and all following adjacent requests of the same type, returns the request after them (NULL if list end) */
+static Dev_Request* dispatchRun(Iosched_Queue* queue, Dev_Request* first)
+{
+	//collect adjacent requests
+	Dev_Request* run[IOSCHED_MERGE_MAX];
+	Dev_IoVec vec[IOSCHED_MERGE_MAX];
+	size_t count = 0;
+	size_t size = 0;
+
+	Dev_Request* request = first;
+	while (request != NULL && count < IOSCHED_MERGE_MAX && request->type == first->type && request->offset == first->offset + size)
+	{
+		run[count] = request;
+		vec[count].base = request->buf;
+		vec[count].size = request->size;
+		size += request->size;
+		count++;
+		request = request->next;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		removeRequest(queue, run[i]);
+
+	queue->position = first->offset + size;
+
+	//single request keeps the asynchronous path of the device
+	if (count == 1)
+	{
+		if (dev_submit(queue->device, first) == ERROR_NONE)
+			queue->operations++;
+		else
+			dev_completeRequest(first, 0, ERROR_DEV_OPERATION_NOT_SUPPORTED);
+
+		return request;
+	}
+
+	//merged requests are transferred with one vectored operation
+	queue->operations++;
+	queue->merged += count - 1;
+	size_t transferred;
+	if (first->type == DEV_REQUEST_TYPE_READ)
+		transferred = dev_readv(queue->device, vec, count, first->offset);
+	else
+		transferred = dev_writev(queue->device, vec, count, first->offset);
+
+	//nothing transferred, the device failed (the requests aren't retried one by one)
+	if (transferred == 0)
+	{
+		for (size_t i = 0; i < count; i++)
+			dev_completeRequest(run[i], 0, ERROR_DEV_IO_FAILED);
+
+		return request;
+	}
+
+	//split transferred bytes among the requests covered by the transfer, a short transfer fails the request it ends in
+	size_t i = 0;
+	for (; i < count && transferred != 0; i++)
+	{
+		size_t part = (transferred < run[i]->size) ? transferred : run[i]->size;
+		transferred -= part;
+		dev_completeRequest(run[i], part, (part == run[i]->size) ? ERROR_NONE : ERROR_OUT_OF_RANGE);
+	}
+
+	//requests behind a short transfer weren't reached, they are executed on their own
+	for (; i < count; i++)
+	{
+		if (dev_submit(queue->device, run[i]) == ERROR_NONE)
+			queue->operations++;
+		else
+			dev_completeRequest(run[i], 0, ERROR_DEV_OPERATION_NOT_SUPPORTED);
+	}
+
+	return request;
+}
+
+void iosched_initQueue(Iosched_Queue* queue, Dev_Device* device, IOSCHED_POLICY policy)
+{
+	queue->device = device;
+	queue->policy = policy;
+	queue->requests = NULL;
+	queue->position = 0;
+
+	queue->depth = 0;
+	queue->maxDepth = 0;
+	queue->submitted = 0;
+	queue->operations = 0;
+	queue->merged = 0;
+}
+
+error_t iosched_submit(Iosched_Queue* queue, Dev_Request* request)
+{
+	//check parameter
+	if (request->buf == NULL)
+		return ERROR_INVALID_ADDRESS;
+
+	queue->submitted++;
+	if (queue->policy == IOSCHED_POLICY_NOOP)
+	{
+		error_t error = dev_submit(queue->device, request);
+		if (error == ERROR_NONE)
+			queue->operations++;
+
+		return error;
+	}
+
+	request->device = queue->device;
+	request->status = DEV_REQUEST_STATUS_PENDING;
+	request->transferred = 0;
+	request->error = ERROR_NONE;
+
+#ifdef DEVSTATS
+	//queued requests are counted by the device operation which transfers them (dev_submit sets the flag for single requests)
+	request->timed = false;
+#endif
+
+	//insert sorted by offset (behind requests with the same offset, so their order is kept)
+	Dev_Request** link = &queue->requests;
+	while (*link != NULL && (*link)->offset <= request->offset)
+		link = &(*link)->next;
+
+	request->next = *link;
+	*link = request;
+
+	queue->depth++;
+	if (queue->depth > queue->maxDepth)
+		queue->maxDepth = queue->depth;
+
+	if (queue->depth >= IOSCHED_QUEUE_DEPTH_MAX)
+		iosched_dispatch(queue);
+
+	return ERROR_NONE;
+}
+
+void iosched_dispatch(Iosched_Queue* queue)
+{
+	//serve requests behind current position in ascending order
+	Dev_Request* request = queue->requests;
+	while (request != NULL && request->offset < queue->position)
+		request = request->next;
+
+	while (request != NULL)
+		request = dispatchRun(queue, request);
+
+	//wrap around and serve the remaining requests
+	while (queue->requests != NULL)
+		dispatchRun(queue, queue->requests);
+}
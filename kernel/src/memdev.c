@@ -0,0 +1,177 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel memory device module.
+ *
+ * The RAM disk is a plain memory region, reads and writes are copies and the region can be mapped directly.
+ * Accesses beyond the end of the region are truncated (like a file), so the transferred size tells the caller where the device ends.
+ */
+
+#include <memdev.h>
+#include <util.h>
+
+static Dev_Device nullDevice;
+static Dev_Device zeroDevice;
+
+/********** RAM disk **********/
+
+static size_t ramClamp(Memdev_Ram* ram, size_t size, size_t offset)
+{
+	if (offset >= ram->size)
+		return 0;
+	if (size > ram->size - offset)
+		return ram->size - offset;
+	return size;
+}
+
+static size_t ramRead(Dev_Device* device, void* buf, size_t size, size_t offset)
+{
+	Memdev_Ram* ram = (Memdev_Ram*)device;
+	size = ramClamp(ram, size, offset);
+	util_memcpy(ram->mem + offset, buf, size);
+	return size;
+}
+
+static size_t ramWrite(Dev_Device* device, const void* buf, size_t size, size_t offset)
+{
+	Memdev_Ram* ram = (Memdev_Ram*)device;
+	size = ramClamp(ram, size, offset);
+	util_memcpy(buf, ram->mem + offset, size);
+	return size;
+}
+
+static error_t ramMap(Dev_Device* device, size_t offset, size_t size, void** outAddr, size_t* outSize)
+{
+	Memdev_Ram* ram = (Memdev_Ram*)device;
+	size = ramClamp(ram, size, offset);
+	if (size == 0)
+		return ERROR_OUT_OF_RANGE;
+
+	*outAddr = ram->mem + offset;
+	*outSize = size;
+	return ERROR_NONE;
+}
+
+error_t memdev_registerRam(Memdev_Ram* ram, uint32_t number, void* mem, size_t size)
+{
+	if (mem == NULL)
+		return ERROR_INVALID_ADDRESS;
+
+	ram->mem = mem;
+	ram->size = size;
+
+	ram->device.name = "ram";
+	ram->device.number = number;
+	ram->device.type = DEV_DEVICE_TYPE_BLOCK;
+	ram->device.read = ramRead;
+	ram->device.write = ramWrite;
+	ram->device.ioctl = NULL;
+	ram->device.readv = NULL;
+	ram->device.writev = NULL;
+	ram->device.map = ramMap;
+	ram->device.unmap = NULL;
+	ram->device.submit = NULL;
+
+	return dev_registerDevice(&ram->device);
+}
+
+error_t memdev_unregisterRam(Memdev_Ram* ram)
+{
+	return dev_unregisterDevice(&ram->device);
+}
+
+/********** null and zero **********/
+
+static size_t nullRead(Dev_Device* device, void* buf, size_t size, size_t offset)
+{
+	return 0;
+}
+
+static size_t nullWrite(Dev_Device* device, const void* buf, size_t size, size_t offset)
+{
+	return size;
+}
+
+static size_t zeroRead(Dev_Device* device, void* buf, size_t size, size_t offset)
+{
+	uint8_t* dst = buf;
+	size_t n = size;
+
+	//byte wise until word aligned, then word wise
+	while (n > 0 && ((uintptr_t)dst & 0x3) != 0)
+	{
+		*dst++ = 0;
+		n--;
+	}
+	for (; n >= sizeof(uint32_t); n -= sizeof(uint32_t), dst += sizeof(uint32_t))
+		*(uint32_t*)dst = 0;
+	while (n > 0)
+	{
+		*dst++ = 0;
+		n--;
+	}
+
+	return size;
+}
+
+static void initCharDevice(Dev_Device* device, const char* name)
+{
+	device->name = name;
+	device->number = 0;
+	device->type = DEV_DEVICE_TYPE_CHAR;
+	device->read = NULL;
+	device->write = NULL;
+	device->ioctl = NULL;
+	device->readv = NULL;
+	device->writev = NULL;
+	device->map = NULL;
+	device->unmap = NULL;
+	device->submit = NULL;
+}
+
+error_t memdev_init(void)
+{
+	initCharDevice(&nullDevice, "null");
+	nullDevice.read = nullRead;
+	nullDevice.write = nullWrite;
+
+	initCharDevice(&zeroDevice, "zero");
+	zeroDevice.read = zeroRead;
+	zeroDevice.write = nullWrite;
+
+	error_t error = dev_registerDevice(&nullDevice);
+	if (error != ERROR_NONE)
+		return error;
+
+	error = dev_registerDevice(&zeroDevice);
+	if (error != ERROR_NONE)
+		dev_unregisterDevice(&nullDevice);
+
+	return error;
+}
+
+void memdev_deinit(void)
+{
+	dev_unregisterDevice(&zeroDevice);
+	dev_unregisterDevice(&nullDevice);
+}
@@ -0,0 +1,141 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel slab module.
+ *
+ * Every cache owns a list of slab chunks and one free list of objects. A new chunk is allocated from heap
+ * when the free list is empty, all its objects are pushed onto the free list. Chunks are only returned to
+ * heap when the cache is deinitialized, so alloc and free are constant time.
+ */
+
+#include <slab.h>
+#include <heap.h>
+
+typedef struct SlabChunk
+{
+	struct SlabChunk* next;
+} SlabChunk;
+
+typedef struct SlabObject
+{
+	struct SlabObject* next;
+} SlabObject;
+
+/* Size of a slab chunk of a cache */
+static size_t chunkSize(const Slab_Cache* cache)
+{
+	return sizeof(SlabChunk) + cache->objectsPerSlab * cache->objectSize;
+}
+
+void slab_initCache(Slab_Cache* cache, const char* name, size_t objectSize)
+{
+	//free objects must be able to hold the free list pointer
+	if (objectSize < sizeof(SlabObject))
+		objectSize = sizeof(SlabObject);
+
+	//make size multiple of 4 (garanties that all objects are aligned with 4)
+	objectSize = (objectSize + 3) & ~3U;
+
+	cache->name = name;
+	cache->objectSize = objectSize;
+
+	//objects which don't fit in a standard chunk get a chunk of their own
+	if (sizeof(SlabChunk) + objectSize > SLAB_CHUNK_SIZE)
+		cache->objectsPerSlab = 1;
+	else
+		cache->objectsPerSlab = (SLAB_CHUNK_SIZE - sizeof(SlabChunk)) / objectSize;
+
+	cache->slabs = NULL;
+	cache->freeObjects = NULL;
+	cache->objectsInUse = 0;
+	cache->slabCount = 0;
+}
+
+void slab_deinitCache(Slab_Cache* cache)
+{
+	SlabChunk* chunk = cache->slabs;
+	while (chunk != NULL)
+	{
+		SlabChunk* next = chunk->next;
+		heap_free(chunk);
+		chunk = next;
+	}
+
+	cache->slabs = NULL;
+	cache->freeObjects = NULL;
+	cache->objectsInUse = 0;
+	cache->slabCount = 0;
+}
+
+void* slab_alloc(Slab_Cache* cache)
+{
+	//if no free object is left, allocate a new chunk
+	if (cache->freeObjects == NULL)
+	{
+		SlabChunk* chunk = heap_alloc(chunkSize(cache));
+		if (chunk == NULL)
+			return NULL;
+
+		chunk->next = cache->slabs;
+		cache->slabs = chunk;
+		cache->slabCount++;
+
+		//push all objects of the chunk on the free list (in reverse order, so objects are handed out by ascending address)
+		uint8_t* objects = (uint8_t*)(chunk + 1);
+		for (size_t i = cache->objectsPerSlab; i > 0; i--)
+		{
+			SlabObject* object = (SlabObject*)(objects + (i-1) * cache->objectSize);
+			object->next = cache->freeObjects;
+			cache->freeObjects = object;
+		}
+	}
+
+	SlabObject* object = cache->freeObjects;
+	cache->freeObjects = object->next;
+	cache->objectsInUse++;
+
+	return object;
+}
+
+void slab_free(Slab_Cache* cache, void* object)
+{
+	if (object == NULL)
+		return;
+
+	SlabObject* node = object;
+	node->next = cache->freeObjects;
+	cache->freeObjects = node;
+	cache->objectsInUse--;
+}
+
+void slab_getStats(const Slab_Cache* cache, Slab_Stats* outStats)
+{
+	size_t objectCount = cache->slabCount * cache->objectsPerSlab;
+
+	outStats->objectSize = cache->objectSize;
+	outStats->objectsInUse = cache->objectsInUse;
+	outStats->objectsFree = objectCount - cache->objectsInUse;
+	outStats->slabCount = cache->slabCount;
+	outStats->slabSize = chunkSize(cache);
+	outStats->wasteSize = cache->slabCount * chunkSize(cache) - objectCount * cache->objectSize;
+}
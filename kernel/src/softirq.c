@@ -0,0 +1,91 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel software interrupt (softirq) module.
+ *
+ * Every priority has a lock-free stack of posted items (see atomic.h, usable from interrupt handlers of any priority).
+ * The PendSV handler takes a whole stack at once, reverses it into posting order and executes the items.
+ * After every batch the queues are checked again starting with the highest priority.
+ */
+
+#include <softirq.h>
+#include <device.h>
+
+#define QUEUE_COUNT (INT_SOFTWARE_LOW_PRIORITY-INT_SOFTWARE_HIGH_PRIORITY+1)
+
+static Atomic_Node* volatile queues[QUEUE_COUNT];	//stacks of posted items, index 0 is the highest priority
+
+static void handlePendSV(void)
+{
+	size_t queue = 0;
+	while (queue < QUEUE_COUNT)
+	{
+		Atomic_Node* node = atomic_takeAll(&queues[queue]);
+		if (node == NULL)
+		{
+			queue++;
+			continue;
+		}
+
+		//stack is in reverse posting order
+		Atomic_Node* batch = NULL;
+		while (node != NULL)
+		{
+			Atomic_Node* next = node->next;
+			node->next = batch;
+			batch = node;
+			node = next;
+		}
+
+		//item may be posted again by its function
+		while (batch != NULL)
+		{
+			Softirq_Item* item = (Softirq_Item*)batch;
+			batch = batch->next;
+			item->func(item);
+		}
+
+		//items of higher priority may have been posted meanwhile
+		queue = 0;
+	}
+}
+
+error_t softirq_init(void)
+{
+	for (size_t i = 0; i < QUEUE_COUNT; i++)
+		queues[i] = NULL;
+
+	if (int_setHandler(INT_PENDSV, handlePendSV) != ERROR_NONE)
+		return ERROR_SOFTIRQ_PENDSV_IN_USE;
+	int_enable(INT_PENDSV, INT_PRIORITY_LOWEST);
+
+	return ERROR_NONE;
+}
+
+void softirq_post(Softirq_Item* item, SOFTIRQ_PRIORITY priority)
+{
+	atomic_push(&queues[priority - INT_SOFTWARE_HIGH_PRIORITY], &item->node);
+
+	//PendSV is taken as soon as no other exception is active (or immediately if called in thread mode)
+	SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+}
@@ -28,7 +28,13 @@
 #include <mpu.h>
 #include <fpu.h>
 #include <heap.h>
+#include <softirq.h>
+#include <workq.h>
 #include <dev.h>
+#include <bcache.h>
+#include <memdev.h>
+#include <devbench.h>
+#include <intbench.h>
 #include <drivers/drivers.h>
 #include <device.h>
 
@@ -37,7 +43,7 @@
  */
 void kernel_start(void)
 {
-	/********** disable all interrupts **********/
+	/********** disable all interrupts (until int_init) **********/
 	__disable_fault_irq();
 	__disable_irq();
 
@@ -99,16 +105,31 @@ void kernel_start(void)
 	heap_init();
 
 	/*********** initialize advanced kernel modules **********/
+	if (softirq_init() != ERROR_NONE)
+		for (;;) {}
+	workq_init();
 	dev_init();
+	if (memdev_init() != ERROR_NONE)
+		for (;;) {}
+	if (bcache_init(BCACHE_BLOCK_SIZE, BCACHE_BUFFER_COUNT) != ERROR_NONE)
+		for (;;) {}
 
 	/********** initialize driver modules **********/
 	if (device_initDrivers() != ERROR_NONE)
 		for (;;) {}
 
 	debug_printf("Kernel is ready.\n");
+#if defined(DEVBENCH) && defined(DEBUG)
+	devbench_runSuite();
+#endif
+#if defined(INTBENCH) && defined(DEBUG)
+	intbench_runSuite();
+#endif
 	led_set(0, LED_ENABLE);
 
-	for (;;) {}
+	//execute deferred work
+	for (;;)
+		workq_run();
 }
 
 /**
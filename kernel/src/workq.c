@@ -0,0 +1,82 @@
+/* The MIT License (MIT)
+ *
+ * Copyright (c) 2015-2016 Christopher Cichos
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* Kernel work queue module.
+ *
+ * Items are kept in a FIFO list. Posting and removal are short kernel critical sections (see int_enterCritical),
+ * the items are executed with interrupts enabled.
+ */
+
+#include <workq.h>
+#include <interrupt.h>
+
+static Workq_Item* head;	//next item to execute
+static Workq_Item* tail;	//last queued item
+
+void workq_init(void)
+{
+	head = NULL;
+	tail = NULL;
+}
+
+void workq_post(Workq_Item* item)
+{
+	item->next = NULL;
+
+	uint32_t state = int_enterCritical();
+
+	if (tail != NULL)
+		tail->next = item;
+	else
+		head = item;
+	tail = item;
+
+	int_exitCritical(state);
+}
+
+bool workq_run(void)
+{
+	bool executed = false;
+	for (;;)
+	{
+		//take first item
+		uint32_t state = int_enterCritical();
+
+		Workq_Item* item = head;
+		if (item != NULL)
+		{
+			head = item->next;
+			if (head == NULL)
+				tail = NULL;
+		}
+
+		int_exitCritical(state);
+
+		if (item == NULL)
+			return executed;
+
+		//item may be posted again by its function
+		item->func(item);
+		executed = true;
+	}
+}